@@ -1,10 +1,37 @@
 #include <Python.h>
 #include <numpy/arrayobject.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 // Forward declarations for env-specific functions supplied by user
 static int my_log(PyObject* dict, Log* log);
 static int my_init(Env* env, PyObject* args, PyObject* kwargs);
 
+// Optional second construction stage, run without the GIL on native threads
+// (never touch Python objects here). my_init parses kwargs; my_init_native
+// does the slow part. Returns 0 on success.
+static int my_init_native(Env* env);
+#ifndef MY_INIT_NATIVE
+static int my_init_native(Env* env) {
+    return 0;
+}
+#endif
+
+// Optional placement stage, run right before my_init_native on the same
+// thread: returns the env to keep, possibly moved into memory local to that
+// thread. Nothing may point into the env yet. my_free_env releases it.
+static Env* my_place_env(Env* env);
+static void my_free_env(Env* env);
+#ifndef MY_PLACE_ENV
+static Env* my_place_env(Env* env) {
+    return env;
+}
+static void my_free_env(Env* env) {
+    free(env);
+}
+#endif
+
 static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs);
 #ifndef MY_SHARED
 static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
@@ -26,6 +53,15 @@ static int my_put(Env* env, PyObject* args, PyObject* kwargs) {
 }
 #endif
 
+// Called by vec_log on every env in the logged range, whether or not any
+// episode finished, for stats that are not per-episode Log floats
+static int my_vec_log(PyObject* dict, Env** envs, int num_envs);
+#ifndef MY_VEC_LOG
+static int my_vec_log(PyObject* dict, Env** envs, int num_envs) {
+    return 0;
+}
+#endif
+
 #ifndef MY_METHODS
 #define MY_METHODS {NULL, NULL, 0, NULL}
 #endif
@@ -58,6 +94,13 @@ static PyObject* env_init(PyObject* self, PyObject* args, PyObject* kwargs) {
         PyErr_SetString(PyExc_MemoryError, "Failed to allocate environment");
         return NULL;
     }
+    // A lone env owns its log slot; vec_init points envs into VecEnv.logs
+    env->log = (Log*)calloc(1, sizeof(Log));
+    if (!env->log) {
+        free(env);
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate environment");
+        return NULL;
+    }
 
     PyObject* obs = PyTuple_GetItem(args, 0);
     if (!PyObject_TypeCheck(obs, &PyArray_Type)) {
@@ -169,6 +212,14 @@ static PyObject* env_init(PyObject* self, PyObject* args, PyObject* kwargs) {
     if (PyErr_Occurred()) {
         return NULL;
     }
+    int failed;
+    Py_BEGIN_ALLOW_THREADS
+    failed = my_init_native(env);
+    Py_END_ALLOW_THREADS
+    if (failed) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to initialize environment");
+        return NULL;
+    }
 
     return PyLong_FromVoidPtr(env);
 }
@@ -221,7 +272,8 @@ static PyObject* env_close(PyObject* self, PyObject* args) {
         return NULL;
     }
     c_close(env);
-    free(env);
+    free(env->log);
+    my_free_env(env);
     Py_RETURN_NONE;
 }
 
@@ -259,11 +311,222 @@ static PyObject* env_put(PyObject* self, PyObject* args, PyObject* kwargs) {
     Py_RETURN_NONE;
 }
 
+// Persistent worker pool: each thread owns a contiguous slice of envs and is
+// optionally pinned to one CPU from the process affinity mask. The caller
+// dispatches an op and waits on the pending count (one barrier per step).
+typedef enum {
+    POOL_STEP,
+    POOL_INIT,
+    POOL_EXIT,
+} PoolOp;
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct {
+    ThreadPool* pool;
+    pthread_t thread;
+    int start;
+    int end;
+} PoolWorker;
+
+struct ThreadPool {
+    Env** envs;
+    PoolWorker* workers;
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;
+    pthread_cond_t done_cv;
+    uint64_t generation;
+    int pending;
+    PoolOp op;
+    int failures; // POOL_INIT envs whose my_init_native failed
+    int init_from; // POOL_INIT skips envs before this (already built)
+};
+
+// Places the env through its slot, so pools and vec->envs see the new one
+static int init_env_native(Env** slot) {
+    *slot = my_place_env(*slot);
+    return my_init_native(*slot);
+}
+
+static void pool_run(ThreadPool* pool, PoolOp op, int start, int end) {
+    switch (op) {
+    case POOL_STEP:
+        for (int i = start; i < end; i++) {
+            c_step(pool->envs[i]);
+        }
+        break;
+    case POOL_INIT:
+        for (int i = start > pool->init_from ? start : pool->init_from; i < end; i++) {
+            if (init_env_native(&pool->envs[i]) != 0) {
+                __atomic_fetch_add(&pool->failures, 1, __ATOMIC_RELAXED);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void* pool_worker_loop(void* arg) {
+    PoolWorker* worker = (PoolWorker*)arg;
+    ThreadPool* pool = worker->pool;
+    uint64_t seen = 0;
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen) {
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        }
+        seen = pool->generation;
+        PoolOp op = pool->op;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (op == POOL_EXIT) {
+            return NULL;
+        }
+        pool_run(pool, op, worker->start, worker->end);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done_cv);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void pool_pin_thread(pthread_t thread, int index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+    int num_cpus = CPU_COUNT(&allowed);
+    if (num_cpus <= 0) {
+        return;
+    }
+    int target = index % num_cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        if (target-- == 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(thread, sizeof(set), &set);
+            return;
+        }
+    }
+}
+
+static void pool_dispatch(ThreadPool* pool, PoolOp op) {
+    pthread_mutex_lock(&pool->lock);
+    // A previous async dispatch must drain before the op is replaced
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    }
+    pool->op = op;
+    pool->pending = pool->num_threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void pool_wait(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// first_cpu < 0 leaves threads unpinned, otherwise thread t is pinned to the
+// (first_cpu + t)-th allowed CPU
+static ThreadPool* pool_create(Env** envs, int num_envs, int num_threads, int first_cpu) {
+    if (num_threads > num_envs) {
+        num_threads = num_envs;
+    }
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->workers = (PoolWorker*)calloc(num_threads, sizeof(PoolWorker));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+    pool->envs = envs;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+
+    for (int t = 0; t < num_threads; t++) {
+        PoolWorker* worker = &pool->workers[t];
+        worker->pool = pool;
+        worker->start = (int)((long)t*num_envs/num_threads);
+        worker->end = (int)((long)(t + 1)*num_envs/num_threads);
+        if (pthread_create(&worker->thread, NULL, pool_worker_loop, worker) != 0) {
+            break;
+        }
+        if (first_cpu >= 0) {
+            pool_pin_thread(worker->thread, first_cpu + t);
+        }
+        pool->num_threads++;
+    }
+
+    // Envs of threads that failed to spawn fall back to the last live worker
+    if (pool->num_threads == 0) {
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->work_cv);
+        pthread_cond_destroy(&pool->done_cv);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pool->workers[pool->num_threads - 1].end = num_envs;
+    return pool;
+}
+
+static void pool_destroy(ThreadPool* pool) {
+    if (!pool) {
+        return;
+    }
+    pool_wait(pool);
+    pool_dispatch(pool, POOL_EXIT);
+    for (int t = 0; t < pool->num_threads; t++) {
+        pthread_join(pool->workers[t].thread, NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_cond_destroy(&pool->done_cv);
+    free(pool->workers);
+    free(pool);
+}
+
+// With num_buffers = 2 the envs are split into two halves, each with its own
+// pool, so vec_send/vec_recv can step one half while the caller runs
+// inference on the other (EnvPool-style double buffering).
+#define MAX_VEC_BUFFERS 2
+
 typedef struct {
     Env** envs;
     int num_envs;
+    int num_buffers;
+    int buffer_start[MAX_VEC_BUFFERS + 1];
+    ThreadPool* pools[MAX_VEC_BUFFERS]; // NULL steps serially on the calling thread
+    // Every env's Log accumulators in one cache-line-aligned block, so
+    // vec_log sweeps contiguous memory instead of one line per env struct.
+    // NULL for vectorize(), whose envs own their logs.
+    Log* logs;
 } VecEnv;
 
+static void vec_wait_all(VecEnv* vec) {
+    for (int b = 0; b < vec->num_buffers; b++) {
+        if (vec->pools[b]) {
+            pool_wait(vec->pools[b]);
+        }
+    }
+}
+
 static VecEnv* unpack_vecenv(PyObject* args) {
     PyObject* handle_obj = PyTuple_GetItem(args, 0);
     if (!PyObject_TypeCheck(handle_obj, &PyLong_Type)) {
@@ -312,6 +575,12 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
         PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env");
         return NULL;
     }
+    size_t logs_bytes = ((num_envs * sizeof(Log)) + 63) & ~(size_t)63;
+    if (posix_memalign((void**)&vec->logs, 64, logs_bytes) != 0) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env");
+        return NULL;
+    }
+    memset(vec->logs, 0, logs_bytes);
 
     PyObject* seed_obj = PyTuple_GetItem(args, 6);
     if (!PyObject_TypeCheck(seed_obj, &PyLong_Type)) {
@@ -410,9 +679,7 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
             return NULL;
         }
         vec->envs[i] = env;
-        
-        // // Make sure the log is initialized to 0
-        memset(&env->log, 0, sizeof(Log));
+        env->log = &vec->logs[i];
         
         env->observations = (void*)((char*)PyArray_DATA(observations) + i*PyArray_STRIDE(observations, 0));
         env->actions = (void*)((char*)PyArray_DATA(actions) + i*PyArray_STRIDE(actions, 0));
@@ -441,6 +708,137 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
         }
     }
 
+    // Optional native stepping threads (num_threads <= 0 keeps serial stepping)
+    int num_threads = 0;
+    int num_buffers = 1;
+    PyObject* num_threads_obj = PyDict_GetItemString(kwargs, "num_threads");
+    if (num_threads_obj && num_threads_obj != Py_None) {
+        num_threads = PyLong_AsLong(num_threads_obj);
+    }
+    PyObject* num_buffers_obj = PyDict_GetItemString(kwargs, "num_buffers");
+    if (num_buffers_obj && num_buffers_obj != Py_None) {
+        num_buffers = PyLong_AsLong(num_buffers_obj);
+    }
+    if (PyErr_Occurred()) {
+        Py_DECREF(kwargs);
+        return NULL;
+    }
+    if (num_buffers < 1 || num_buffers > MAX_VEC_BUFFERS || num_buffers > num_envs) {
+        PyErr_SetString(PyExc_ValueError, "num_buffers must be 1 or 2 and at most num_envs");
+        Py_DECREF(kwargs);
+        return NULL;
+    }
+    PyObject* pin_obj = PyDict_GetItemString(kwargs, "pin_threads");
+    bool pin_threads = pin_obj && PyObject_IsTrue(pin_obj) == 1;
+    // Position among sibling worker processes (Multiprocessing), so pinned
+    // pools of different workers start on different CPUs instead of all
+    // stacking onto the first ones
+    int worker_index = 0;
+    int num_workers = 1;
+    PyObject* worker_index_obj = PyDict_GetItemString(kwargs, "worker_index");
+    if (worker_index_obj && worker_index_obj != Py_None) {
+        worker_index = PyLong_AsLong(worker_index_obj);
+    }
+    PyObject* num_workers_obj = PyDict_GetItemString(kwargs, "num_workers");
+    if (num_workers_obj && num_workers_obj != Py_None) {
+        num_workers = PyLong_AsLong(num_workers_obj);
+    }
+    if (PyErr_Occurred()) {
+        Py_DECREF(kwargs);
+        return NULL;
+    }
+    if (num_workers < 1 || worker_index < 0 || worker_index >= num_workers) {
+        PyErr_SetString(PyExc_ValueError, "worker_index must be in [0, num_workers)");
+        Py_DECREF(kwargs);
+        return NULL;
+    }
+
+    vec->num_buffers = num_buffers;
+    for (int b = 0; b <= num_buffers; b++) {
+        vec->buffer_start[b] = (int)((long)b*num_envs/num_buffers);
+    }
+    // Async halves always need at least one background thread each
+    int threads_per_buffer = num_threads / num_buffers;
+    if (num_buffers > 1 && threads_per_buffer < 1) {
+        threads_per_buffer = 1;
+    }
+    if (threads_per_buffer > 0) {
+        int worker_first_cpu = worker_index*threads_per_buffer*num_buffers;
+        for (int b = 0; b < num_buffers; b++) {
+            int start = vec->buffer_start[b];
+            int count = vec->buffer_start[b + 1] - start;
+            int first_cpu = pin_threads ? worker_first_cpu + b*threads_per_buffer : -1;
+            vec->pools[b] = pool_create(vec->envs + start, count, threads_per_buffer, first_cpu);
+            if (!vec->pools[b]) {
+                PyErr_SetString(PyExc_RuntimeError, "Failed to start env threads");
+                Py_DECREF(kwargs);
+                return NULL;
+            }
+        }
+    }
+
+    // Native construction runs in parallel with the GIL released. With
+    // clone_from_template, env 0 initializes alone first so the rest can
+    // restore whatever it leaves behind instead of redoing the work. With
+    // pinned stepping threads, each env is built on the thread that will
+    // step it, so everything it first-touches is local to that CPU.
+    int init_threads = 0;
+    PyObject* init_threads_obj = PyDict_GetItemString(kwargs, "init_threads");
+    if (init_threads_obj && init_threads_obj != Py_None) {
+        init_threads = PyLong_AsLong(init_threads_obj);
+    }
+    if (init_threads <= 0) {
+        // Sibling workers build their envs at the same time: split the CPUs
+        init_threads = (int)sysconf(_SC_NPROCESSORS_ONLN) / num_workers;
+        if (init_threads < 1) {
+            init_threads = 1;
+        }
+    }
+    PyObject* clone_obj = PyDict_GetItemString(kwargs, "clone_from_template");
+    bool clone_from_template = clone_obj && PyObject_IsTrue(clone_obj) == 1;
+    if (PyErr_Occurred()) {
+        Py_DECREF(kwargs);
+        return NULL;
+    }
+    bool init_on_pools = pin_threads && vec->pools[0];
+    int init_failures = 0;
+    Py_BEGIN_ALLOW_THREADS
+    int first = 0;
+    if (clone_from_template) {
+        init_failures += init_env_native(&vec->envs[0]) != 0;
+        first = 1;
+    }
+    ThreadPool* init_pool = NULL;
+    if (init_on_pools) {
+        vec->pools[0]->init_from = first;
+        for (int b = 0; b < num_buffers; b++) {
+            pool_dispatch(vec->pools[b], POOL_INIT);
+        }
+        for (int b = 0; b < num_buffers; b++) {
+            pool_wait(vec->pools[b]);
+            init_failures += vec->pools[b]->failures;
+        }
+    } else if (init_threads > 1 && num_envs - first > 1) {
+        init_pool = pool_create(vec->envs + first, num_envs - first, init_threads, -1);
+    }
+    if (init_pool) {
+        pool_dispatch(init_pool, POOL_INIT);
+        pool_wait(init_pool);
+        init_failures += init_pool->failures;
+        pool_destroy(init_pool);
+    } else if (!init_on_pools) {
+        for (int i = first; i < num_envs; i++) {
+            init_failures += init_env_native(&vec->envs[i]) != 0;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (init_failures > 0) {
+        PyErr_Format(PyExc_RuntimeError, "Failed to initialize %d of %d environments",
+            init_failures, num_envs);
+        Py_DECREF(kwargs);
+        return NULL;
+    }
+
     Py_DECREF(kwargs);
     return PyLong_FromVoidPtr(vec);
 }
@@ -475,6 +873,8 @@ static PyObject* vectorize(PyObject* self, PyObject* args) {
         }
         vec->envs[i] = (Env*)PyLong_AsVoidPtr(handle_obj);
     }
+    vec->num_buffers = 1;
+    vec->buffer_start[1] = num_envs;
 
     return PyLong_FromVoidPtr(vec);
 }
@@ -497,6 +897,9 @@ static PyObject* vec_reset(PyObject* self, PyObject* args) {
     }
     int seed = PyLong_AsLong(seed_arg);
  
+    Py_BEGIN_ALLOW_THREADS
+    vec_wait_all(vec);
+    Py_END_ALLOW_THREADS
     for (int i = 0; i < vec->num_envs; i++) {
         // Assumes each process has the same number of environments
         srand(i + seed*vec->num_envs);
@@ -517,8 +920,84 @@ static PyObject* vec_step(PyObject* self, PyObject* arg) {
         return NULL;
     }
 
-    for (int i = 0; i < vec->num_envs; i++) {
-        c_step(vec->envs[i]);
+    Py_BEGIN_ALLOW_THREADS
+    for (int b = 0; b < vec->num_buffers; b++) {
+        if (vec->pools[b]) {
+            pool_dispatch(vec->pools[b], POOL_STEP);
+        } else {
+            for (int i = vec->buffer_start[b]; i < vec->buffer_start[b + 1]; i++) {
+                c_step(vec->envs[i]);
+            }
+        }
+    }
+    vec_wait_all(vec);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+static int unpack_buffer(VecEnv* vec, PyObject* args) {
+    PyObject* buffer_arg = PyTuple_GetItem(args, 1);
+    if (!buffer_arg || !PyObject_TypeCheck(buffer_arg, &PyLong_Type)) {
+        PyErr_SetString(PyExc_TypeError, "buffer must be an integer");
+        return -1;
+    }
+    int buffer = PyLong_AsLong(buffer_arg);
+    if (buffer < 0 || buffer >= vec->num_buffers) {
+        PyErr_SetString(PyExc_ValueError, "buffer out of range");
+        return -1;
+    }
+    return buffer;
+}
+
+// Starts stepping one half and returns immediately; actions must already be
+// written for that half. Pair with vec_recv on the same buffer.
+static PyObject* vec_send(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 2) {
+        PyErr_SetString(PyExc_TypeError, "vec_send requires 2 arguments");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    int buffer = unpack_buffer(vec, args);
+    if (buffer < 0) {
+        return NULL;
+    }
+
+    ThreadPool* pool = vec->pools[buffer];
+    Py_BEGIN_ALLOW_THREADS
+    if (pool) {
+        pool_dispatch(pool, POOL_STEP);
+    } else {
+        for (int i = vec->buffer_start[buffer]; i < vec->buffer_start[buffer + 1]; i++) {
+            c_step(vec->envs[i]);
+        }
+    }
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+// Blocks until the half started by vec_send has finished its step
+static PyObject* vec_recv(PyObject* self, PyObject* args) {
+    if (PyTuple_Size(args) != 2) {
+        PyErr_SetString(PyExc_TypeError, "vec_recv requires 2 arguments");
+        return NULL;
+    }
+    VecEnv* vec = unpack_vecenv(args);
+    if (!vec) {
+        return NULL;
+    }
+    int buffer = unpack_buffer(vec, args);
+    if (buffer < 0) {
+        return NULL;
+    }
+
+    ThreadPool* pool = vec->pools[buffer];
+    if (pool) {
+        Py_BEGIN_ALLOW_THREADS
+        pool_wait(pool);
+        Py_END_ALLOW_THREADS
     }
     Py_RETURN_NONE;
 }
@@ -542,7 +1021,11 @@ static PyObject* vec_render(PyObject* self, PyObject* args) {
         return NULL;
     }
     int env_id = PyLong_AsLong(env_id_arg);
- 
+
+    // Drawing reads the core, so no half may still be stepping it
+    Py_BEGIN_ALLOW_THREADS
+    vec_wait_all(vec);
+    Py_END_ALLOW_THREADS
     c_render(vec->envs[env_id]);
     Py_RETURN_NONE;
 }
@@ -567,19 +1050,48 @@ static PyObject* vec_log(PyObject* self, PyObject* args) {
         return NULL;
     }
 
+    // Optional buffer index: only aggregate that half. Either way the envs
+    // read here are drained first, since their steps write the logs.
+    int start = 0;
+    int end = vec->num_envs;
+    ThreadPool* pool = NULL;
+    if (PyTuple_Size(args) > 1) {
+        int buffer = unpack_buffer(vec, args);
+        if (buffer < 0) {
+            return NULL;
+        }
+        start = vec->buffer_start[buffer];
+        end = vec->buffer_start[buffer + 1];
+        pool = vec->pools[buffer];
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (start == 0 && end == vec->num_envs) {
+        vec_wait_all(vec);
+    } else if (pool) {
+        pool_wait(pool);
+    }
+    Py_END_ALLOW_THREADS
+
     // Iterates over logs one float at a time. Will break
     // horribly if Log has non-float data.
     Log aggregate = {0};
     int num_keys = sizeof(Log) / sizeof(float);
-    for (int i = 0; i < vec->num_envs; i++) {
-        Env* env = vec->envs[i];
+    float* sum = (float*)&aggregate;
+    for (int i = start; i < end; i++) {
+        // Contiguous slots when vec->logs is set, so this streams them
+        // without touching the env structs
+        float* log = (float*)(vec->logs ? vec->logs + i : vec->envs[i]->log);
         for (int j = 0; j < num_keys; j++) {
-            ((float*)&aggregate)[j] += ((float*)&env->log)[j];
-            ((float*)&env->log)[j] = 0.0f;
+            sum[j] += log[j];
         }
+        memset(log, 0, sizeof(Log));
     }
 
     PyObject* dict = PyDict_New();
+    if (my_vec_log(dict, vec->envs + start, end - start) < 0) {
+        Py_DECREF(dict);
+        return NULL;
+    }
     if (aggregate.n == 0.0f) {
         return dict;
     }
@@ -603,10 +1115,20 @@ static PyObject* vec_close(PyObject* self, PyObject* args) {
         return NULL;
     }
 
+    Py_BEGIN_ALLOW_THREADS
+    for (int b = 0; b < vec->num_buffers; b++) {
+        pool_destroy(vec->pools[b]);
+        vec->pools[b] = NULL;
+    }
+    Py_END_ALLOW_THREADS
     for (int i = 0; i < vec->num_envs; i++) {
         c_close(vec->envs[i]);
-        free(vec->envs[i]);
+        if (!vec->logs) {
+            free(vec->envs[i]->log);
+        }
+        my_free_env(vec->envs[i]);
     }
+    free(vec->logs);
     free(vec->envs);
     free(vec);
     Py_RETURN_NONE;
@@ -653,6 +1175,8 @@ static PyMethodDef methods[] = {
     {"vec_init", (PyCFunction)vec_init, METH_VARARGS | METH_KEYWORDS, "Initialize a vector of environments"},
     {"vec_reset", vec_reset, METH_VARARGS, "Reset the vector of environments"},
     {"vec_step", vec_step, METH_VARARGS, "Step the vector of environments"},
+    {"vec_send", vec_send, METH_VARARGS, "Start stepping one env buffer asynchronously"},
+    {"vec_recv", vec_recv, METH_VARARGS, "Wait for an env buffer started by vec_send"},
     {"vec_log", vec_log, METH_VARARGS, "Log the vector of environments"},
     {"vec_render", vec_render, METH_VARARGS, "Render the vector of environments"},
     {"vec_close", vec_close, METH_VARARGS, "Close the vector of environments"},
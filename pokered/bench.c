@@ -0,0 +1,443 @@
+// bench.c - Headless native benchmark (no Python, no multiprocessing)
+// Steps N envs across M threads with random or recorded actions and reports
+// SPS, frames/sec, RSS and (PROFILE=1 builds) per-phase timing.
+//
+//   ./pokered_bench -n 32 -t 8 -s 20000 -f 4 -o uint8
+#include "pokered.h"
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  int num_envs;
+  int num_threads;
+  int steps; // per env
+  int frameskip;
+  bool adaptive_frameskip;
+  int max_frameskip;
+  bool macro_actions;
+  bool lazy_render;
+  bool fast_options;
+  bool instant_text;
+  int max_episode_length;
+  bool full_reset;
+  int obs_mode;
+  const char *rewards; // reward_components list
+  uint32_t reward_components;
+  int event_scan_interval;
+  unsigned int seed;
+  const char *rom_path;
+  const char *state_path;
+  const char *actions_path;
+} BenchConfig;
+
+typedef struct {
+  const BenchConfig *cfg;
+  PokemonRedEnv *envs;
+  int start;
+  int end;
+  const uint8_t *actions; // recorded actions, NULL = random
+  size_t num_actions;
+  int failures;
+  uint64_t frames; // emulated during the timed run
+} BenchWorker;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// VmRSS / VmHWM in MiB from /proc (0 where unavailable)
+static void read_rss(double *rss_mib, double *peak_mib) {
+  *rss_mib = *peak_mib = 0.0;
+  FILE *f = fopen("/proc/self/status", "r");
+  if (!f)
+    return;
+  char line[256];
+  long kb;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "VmRSS: %ld kB", &kb) == 1)
+      *rss_mib = kb / 1024.0;
+    else if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+      *peak_mib = kb / 1024.0;
+  }
+  fclose(f);
+}
+
+static uint8_t *load_actions(const char *path, size_t *count) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *actions = size > 0 ? (uint8_t *)malloc((size_t)size) : NULL;
+  if (actions && fread(actions, 1, (size_t)size, f) != (size_t)size) {
+    free(actions);
+    actions = NULL;
+  }
+  fclose(f);
+  *count = actions ? (size_t)size : 0;
+  return actions;
+}
+
+// Config as binding.c my_init would set it, then the shared construction
+static int bench_init_env(PokemonRedEnv *env, const BenchConfig *cfg, int id) {
+  env->env_id = id;
+  env->emu.frame_skip = cfg->frameskip;
+  env->adaptive_frameskip = cfg->adaptive_frameskip;
+  env->max_frameskip = cfg->max_frameskip;
+  env->macro_actions = cfg->macro_actions;
+  env->lazy_render = cfg->lazy_render;
+  env->fast_options = cfg->fast_options;
+  env->instant_text = cfg->instant_text;
+  env->max_episode_length = cfg->max_episode_length;
+  env->emu.render_enabled = false;
+  env->full_reset = cfg->full_reset;
+  env->obs_mode = cfg->obs_mode;
+  env->reward_weights = REWARD_DEFAULTS;
+  env->event_scan_interval = cfg->event_scan_interval;
+  select_rewards(env, cfg->reward_components);
+  strncpy(env->emu.rom_path, cfg->rom_path, sizeof(env->emu.rom_path) - 1);
+  strncpy(env->emu.state_path, cfg->state_path,
+          sizeof(env->emu.state_path) - 1);
+  // Always start from the state file so runs are comparable
+  env->clone_from_template = true;
+  allocate(env);
+
+  if (pokered_init_env(env) != 0)
+    return -1;
+  if (!env->full_reset)
+    mgba_release_cached_state(&env->emu);
+  c_reset(env);
+  return 0;
+}
+
+static void *bench_init_thread(void *arg) {
+  BenchWorker *w = (BenchWorker *)arg;
+  for (int i = w->start; i < w->end; i++) {
+    if (bench_init_env(&w->envs[i], w->cfg, i) != 0)
+      w->failures++;
+  }
+  return NULL;
+}
+
+static void *bench_step_thread(void *arg) {
+  BenchWorker *w = (BenchWorker *)arg;
+  unsigned int rng = w->cfg->seed + (unsigned int)w->start;
+  int action_space =
+      w->cfg->macro_actions ? MACRO_ACTION_SPACE : GB_ACTION_COUNT;
+  for (int s = 0; s < w->cfg->steps; s++) {
+    for (int i = w->start; i < w->end; i++) {
+      PokemonRedEnv *env = &w->envs[i];
+      if (w->actions)
+        env->actions[0] = w->actions[((size_t)s * w->cfg->num_envs + i) %
+                                     w->num_actions] %
+                          action_space;
+      else
+        env->actions[0] = (int)(rand_r(&rng) % action_space);
+      c_step(env);
+      w->frames += (uint64_t)env->last_step_frames;
+      // Nobody drains the rings here
+      Milestone m;
+      while (milestone_pop(&env->milestones, &m))
+        ;
+    }
+  }
+  return NULL;
+}
+
+// Runs fn over the env slices on cfg->num_threads threads
+static int run_threads(BenchWorker *workers, const BenchConfig *cfg,
+                       void *(*fn)(void *)) {
+  pthread_t *threads =
+      (pthread_t *)calloc((size_t)cfg->num_threads, sizeof(pthread_t));
+  if (!threads)
+    return -1;
+  for (int t = 0; t < cfg->num_threads; t++)
+    pthread_create(&threads[t], NULL, fn, &workers[t]);
+  int failures = 0;
+  for (int t = 0; t < cfg->num_threads; t++) {
+    pthread_join(threads[t], NULL);
+    failures += workers[t].failures;
+  }
+  free(threads);
+  return failures;
+}
+
+#ifdef ENABLE_PERF_COUNTERS
+static void print_perf(PokemonRedEnv *envs, int num_envs) {
+  PerfCounters total = {0};
+  for (int i = 0; i < num_envs; i++) {
+    for (int p = 0; p < PERF_PHASE_COUNT; p++)
+      total.phase_ns[p] += envs[i].perf.phase_ns[p];
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+      total.hist[b] += envs[i].perf.hist[b];
+    total.step_ns += envs[i].perf.step_ns;
+    total.steps += envs[i].perf.steps;
+  }
+  if (total.steps == 0)
+    return;
+  double steps = (double)total.steps;
+  printf("phase         us/step   share\n");
+  for (int p = 0; p < PERF_PHASE_COUNT; p++)
+    printf("  %-10s %9.2f  %5.1f%%\n", PERF_PHASE_NAMES[p],
+           total.phase_ns[p] / steps / 1e3,
+           100.0 * total.phase_ns[p] / total.step_ns);
+  printf("step latency  mean %.2f us  p50 %.2f  p90 %.2f  p99 %.2f\n",
+         total.step_ns / steps / 1e3,
+         perf_percentile_ns(total.hist, total.steps, 0.50) / 1e3,
+         perf_percentile_ns(total.hist, total.steps, 0.90) / 1e3,
+         perf_percentile_ns(total.hist, total.steps, 0.99) / 1e3);
+}
+#endif
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -n, --envs N          environments (default 8)\n"
+          "  -t, --threads M       stepping threads (default 1)\n"
+          "  -s, --steps S         steps per env (default 10000)\n"
+          "  -f, --frameskip F     frames per step (default 4)\n"
+          "  -A, --adaptive CAP    adaptive frameskip up to CAP frames/step\n"
+          "  -m, --macros          add the macro actions to the action space\n"
+          "  -L, --lazy-render     draw only the last frame of each step\n"
+          "  -F, --fast-options    fast text, no battle animations, set style\n"
+          "  -I, --instant-text    print text without letter delay\n"
+          "  -e, --episode-length L  max episode length (default 20480)\n"
+          "  -r, --full-reset 0|1  restore the state file on reset (default 1)\n"
+          "  -o, --obs MODE        float32 | uint8 | packed | tilemap\n"
+          "                        (default float32)\n"
+          "  -a, --actions FILE    recorded actions, one byte each (default random)\n"
+          "      --rom PATH        ROM (default ./pokemon_red.gb)\n"
+          "      --state PATH      state (default pokered/states/new_start.ss1)\n"
+          "      --seed N          RNG seed for random actions (default 0)\n"
+          "      --rewards LIST    reward components, e.g. badge,coord "
+          "(default all)\n"
+          "      --event-interval K  scan event flags every K steps "
+          "(default 1)\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  BenchConfig cfg = {
+      .num_envs = 8,
+      .num_threads = 1,
+      .steps = 10000,
+      .frameskip = 4,
+      .adaptive_frameskip = false,
+      .max_frameskip = 64,
+      .macro_actions = false,
+      .lazy_render = false,
+      .fast_options = false,
+      .instant_text = false,
+      .max_episode_length = 20480,
+      .full_reset = true,
+      .obs_mode = OBS_MODE_FLOAT,
+      .rewards = "all",
+      .reward_components = REWARD_ALL,
+      .event_scan_interval = 1,
+      .seed = 0,
+      .rom_path = "./pokemon_red.gb",
+      .state_path = "pokered/states/new_start.ss1",
+      .actions_path = NULL,
+  };
+  static const struct option options[] = {
+      {"envs", required_argument, NULL, 'n'},
+      {"threads", required_argument, NULL, 't'},
+      {"steps", required_argument, NULL, 's'},
+      {"frameskip", required_argument, NULL, 'f'},
+      {"adaptive", required_argument, NULL, 'A'},
+      {"macros", no_argument, NULL, 'm'},
+      {"lazy-render", no_argument, NULL, 'L'},
+      {"fast-options", no_argument, NULL, 'F'},
+      {"instant-text", no_argument, NULL, 'I'},
+      {"episode-length", required_argument, NULL, 'e'},
+      {"full-reset", required_argument, NULL, 'r'},
+      {"obs", required_argument, NULL, 'o'},
+      {"actions", required_argument, NULL, 'a'},
+      {"rom", required_argument, NULL, 1},
+      {"state", required_argument, NULL, 2},
+      {"seed", required_argument, NULL, 3},
+      {"rewards", required_argument, NULL, 4},
+      {"event-interval", required_argument, NULL, 5},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:t:s:f:A:mLFIe:r:o:a:h", options, NULL)) !=
+         -1) {
+    switch (opt) {
+    case 'n':
+      cfg.num_envs = atoi(optarg);
+      break;
+    case 't':
+      cfg.num_threads = atoi(optarg);
+      break;
+    case 's':
+      cfg.steps = atoi(optarg);
+      break;
+    case 'f':
+      cfg.frameskip = atoi(optarg);
+      break;
+    case 'A':
+      cfg.adaptive_frameskip = true;
+      cfg.max_frameskip = atoi(optarg);
+      break;
+    case 'm':
+      cfg.macro_actions = true;
+      break;
+    case 'L':
+      cfg.lazy_render = true;
+      break;
+    case 'F':
+      cfg.fast_options = true;
+      break;
+    case 'I':
+      cfg.instant_text = true;
+      break;
+    case 'e':
+      cfg.max_episode_length = atoi(optarg);
+      break;
+    case 'r':
+      cfg.full_reset = atoi(optarg) != 0;
+      break;
+    case 'o':
+      if (strcmp(optarg, "float32") == 0)
+        cfg.obs_mode = OBS_MODE_FLOAT;
+      else if (strcmp(optarg, "uint8") == 0)
+        cfg.obs_mode = OBS_MODE_UINT8;
+      else if (strcmp(optarg, "packed") == 0)
+        cfg.obs_mode = OBS_MODE_PACKED;
+      else if (strcmp(optarg, "tilemap") == 0)
+        cfg.obs_mode = OBS_MODE_TILEMAP;
+      else {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'a':
+      cfg.actions_path = optarg;
+      break;
+    case 1:
+      cfg.rom_path = optarg;
+      break;
+    case 2:
+      cfg.state_path = optarg;
+      break;
+    case 3:
+      cfg.seed = (unsigned int)strtoul(optarg, NULL, 10);
+      break;
+    case 4:
+      cfg.rewards = optarg;
+      if (!parse_reward_components(optarg, &cfg.reward_components)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 5:
+      cfg.event_scan_interval = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (cfg.num_envs < 1 || cfg.num_threads < 1 || cfg.steps < 1 ||
+      cfg.frameskip < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (cfg.num_threads > cfg.num_envs)
+    cfg.num_threads = cfg.num_envs;
+
+  uint8_t *actions = NULL;
+  size_t num_actions = 0;
+  if (cfg.actions_path) {
+    actions = load_actions(cfg.actions_path, &num_actions);
+    if (!actions) {
+      fprintf(stderr, "Could not read actions file: %s\n", cfg.actions_path);
+      return 1;
+    }
+  }
+
+  PokemonRedEnv *envs =
+      (PokemonRedEnv *)calloc((size_t)cfg.num_envs, sizeof(PokemonRedEnv));
+  BenchWorker *workers =
+      (BenchWorker *)calloc((size_t)cfg.num_threads, sizeof(BenchWorker));
+  if (!envs || !workers) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  for (int t = 0; t < cfg.num_threads; t++) {
+    workers[t].cfg = &cfg;
+    workers[t].envs = envs;
+    workers[t].start = (int)((long)t * cfg.num_envs / cfg.num_threads);
+    workers[t].end = (int)((long)(t + 1) * cfg.num_envs / cfg.num_threads);
+    workers[t].actions = actions;
+    workers[t].num_actions = num_actions;
+  }
+
+  static const char *const obs_names[] = {"float32", "uint8", "packed",
+                                            "tilemap"};
+  printf("pokered_bench: %d envs, %d threads, %d steps/env, "
+         "frameskip %d%s%s%s%s, full_reset %d, obs %s, %s%s actions, "
+         "rewards %s (events every %d)\n",
+         cfg.num_envs, cfg.num_threads, cfg.steps, cfg.frameskip,
+         cfg.adaptive_frameskip ? " (adaptive)" : "",
+         cfg.lazy_render ? " lazy-render" : "",
+         cfg.fast_options ? " fast-options" : "",
+         cfg.instant_text ? " instant-text" : "", cfg.full_reset,
+         obs_names[cfg.obs_mode], actions ? "recorded" : "random",
+         cfg.macro_actions ? " macro" : "", cfg.rewards,
+         cfg.event_scan_interval);
+
+  double t0 = now_sec();
+  if (run_threads(workers, &cfg, bench_init_thread) != 0) {
+    fprintf(stderr, "Failed to initialize environments\n");
+    return 1;
+  }
+  double init_s = now_sec() - t0;
+#ifdef ENABLE_PERF_COUNTERS
+  // Only measure the stepping loop
+  for (int i = 0; i < cfg.num_envs; i++)
+    memset(&envs[i].perf, 0, sizeof(envs[i].perf));
+#endif
+
+  t0 = now_sec();
+  run_threads(workers, &cfg, bench_step_thread);
+  double run_s = now_sec() - t0;
+
+  double total_steps = (double)cfg.num_envs * cfg.steps;
+  double total_frames = 0.0;
+  for (int t = 0; t < cfg.num_threads; t++)
+    total_frames += (double)workers[t].frames;
+  double rss, peak;
+  read_rss(&rss, &peak);
+  printf("init          %.3f s (%.2f ms/env)\n", init_s,
+         1e3 * init_s / cfg.num_envs);
+  printf("run           %.3f s\n", run_s);
+  printf("SPS           %.0f\n", total_steps / run_s);
+  printf("frames/sec    %.0f (%.2f frames/step)\n", total_frames / run_s,
+         total_frames / total_steps);
+  printf("RSS           %.1f MiB (peak %.1f MiB, %.2f MiB/env)\n", rss, peak,
+         rss / cfg.num_envs);
+#ifdef ENABLE_PERF_COUNTERS
+  print_perf(envs, cfg.num_envs);
+#else
+  printf("(build with PROFILE=1 for per-phase timing)\n");
+#endif
+
+  for (int i = 0; i < cfg.num_envs; i++) {
+    c_close(&envs[i]);
+    free_allocated(&envs[i]);
+  }
+  free(envs);
+  free(workers);
+  free(actions);
+  return 0;
+}
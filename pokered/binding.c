@@ -1,46 +1,332 @@
+#define _GNU_SOURCE // CPU affinity for the env thread pool
+
 #include "./includes/mgba_wrapper.h"
 #include "pokered.h"
 #include <Python.h>
 
 #define Env PokemonRedEnv
-#define MAX_MAPS 256
-#define MAX_X 256
-#define MAX_Y 256
-#define VISITED_COORDS_SIZE (MAX_MAPS * MAX_X * MAX_Y)
 
 static int g_env_init_counter = 0;
+// Frontier archive settings, the same for every env in the vec
+static char g_archive_name[48];
+static uint32_t g_archive_cells = 0;
+// Node-wide visit map, likewise shared by the whole vec
+static char g_visitmap_name[48];
+static uint32_t g_visitmap_blocks = 0;
+// Per-env trajectory files go to g_record_dir when it is set
+static char g_record_dir[200];
+static uint32_t g_record_keyframes = 0;
+// Per-env arenas (arena.h), placed on the thread that builds the env
+static bool g_env_arenas = false;
+static bool g_huge_pages = false;
+
+static PyObject *vec_snapshot(PyObject *self, PyObject *args);
+static PyObject *vec_restore(PyObject *self, PyObject *args);
+static PyObject *vec_release(PyObject *self, PyObject *args);
+static PyObject *vec_visit_map(PyObject *self, PyObject *args);
+static PyObject *vec_telemetry_init(PyObject *self, PyObject *args);
+
+// Process-wide so a snapshot taken in one env can be restored into any other
+static SnapshotArena g_snapshots;
 
-static PyObject *vec_get_positions(PyObject *self, PyObject *args);
+#define MY_VEC_LOG
+#define MY_INIT_NATIVE
+#define MY_PLACE_ENV
 
 #define MY_METHODS                                                             \
-  {"vec_get_positions", vec_get_positions, METH_VARARGS,                       \
-   "Get positions of all envs"}
+  {"vec_snapshot", vec_snapshot, METH_VARARGS,                                 \
+   "Snapshot envs in memory, returns one handle per env id"},                  \
+      {"vec_restore", vec_restore, METH_VARARGS,                               \
+       "Restore envs from snapshot handles"},                                  \
+      {"vec_release", vec_release, METH_VARARGS,                               \
+       "Return snapshot handles to the arena"},                                \
+      {"vec_visit_map", vec_visit_map, METH_VARARGS,                           \
+       "Writable views of the shared visit map (directory, counts) or None"},  \
+      {"vec_telemetry_init", vec_telemetry_init, METH_VARARGS,                 \
+       "Have envs write per-step telemetry into an int16 array, or stop (None)"}
 
 #include "../env_binding.h"
 
-static PyObject *vec_get_positions(PyObject *self, PyObject *args) {
+// Reads a sequence of env ids into a new int array, NULL with an error set
+static int *unpack_env_ids(VecEnv *vec, PyObject *seq_obj, Py_ssize_t *count) {
+  PyObject *seq = PySequence_Fast(seq_obj, "env_ids must be a sequence");
+  if (!seq)
+    return NULL;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+  int *ids = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+  if (!ids) {
+    Py_DECREF(seq);
+    PyErr_NoMemory();
+    return NULL;
+  }
+  for (Py_ssize_t i = 0; i < n; i++) {
+    long id = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+    if (id < 0 || id >= vec->num_envs) {
+      if (!PyErr_Occurred())
+        PyErr_Format(PyExc_IndexError, "env id %ld out of range", id);
+      free(ids);
+      Py_DECREF(seq);
+      return NULL;
+    }
+    ids[i] = (int)id;
+  }
+  Py_DECREF(seq);
+  *count = n;
+  return ids;
+}
+
+static PyObject *vec_snapshot(PyObject *self, PyObject *args) {
+  if (PyTuple_Size(args) != 2) {
+    PyErr_SetString(PyExc_TypeError, "vec_snapshot requires 2 arguments");
+    return NULL;
+  }
   VecEnv *vec = unpack_vecenv(args);
   if (!vec)
     return NULL;
+  Py_ssize_t n;
+  int *ids = unpack_env_ids(vec, PyTuple_GetItem(args, 1), &n);
+  if (!ids)
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  vec_wait_all(vec);
+  Py_END_ALLOW_THREADS
 
-  PyObject *list = PyList_New(vec->num_envs);
-  for (int i = 0; i < vec->num_envs; i++) {
-    Env *env = vec->envs[i];
+  PyObject *handles = PyList_New(n);
+  Py_ssize_t taken = 0;
+  for (; handles && taken < n; taken++) {
+    Env *env = vec->envs[ids[taken]];
+    if (!snapshot_arena_configure(&g_snapshots,
+                                  savestate_size(env->emu.core),
+                                  snapshot_env_size(env))) {
+      PyErr_SetString(PyExc_ValueError,
+                      "env does not match the snapshot arena layout");
+      break;
+    }
+    int64_t handle;
+    Snapshot *snap = snapshot_alloc(&g_snapshots, &handle);
+    if (!snap) {
+      PyErr_NoMemory();
+      break;
+    }
+    if (!c_snapshot(env, &g_snapshots, snap)) {
+      snapshot_release(&g_snapshots, handle);
+      PyErr_Format(PyExc_RuntimeError, "failed to snapshot env %d",
+                   ids[taken]);
+      break;
+    }
+    PyList_SET_ITEM(handles, taken, PyLong_FromLongLong(handle));
+  }
+  // On failure the snapshots already taken go back to the arena
+  if (handles && taken < n) {
+    for (Py_ssize_t i = 0; i < taken; i++)
+      snapshot_release(&g_snapshots,
+                       PyLong_AsLongLong(PyList_GET_ITEM(handles, i)));
+    Py_CLEAR(handles);
+  }
+  free(ids);
+  return handles;
+}
+
+static PyObject *vec_restore(PyObject *self, PyObject *args) {
+  if (PyTuple_Size(args) != 3) {
+    PyErr_SetString(PyExc_TypeError, "vec_restore requires 3 arguments");
+    return NULL;
+  }
+  VecEnv *vec = unpack_vecenv(args);
+  if (!vec)
+    return NULL;
+  Py_ssize_t n;
+  int *ids = unpack_env_ids(vec, PyTuple_GetItem(args, 1), &n);
+  if (!ids)
+    return NULL;
+  PyObject *handles =
+      PySequence_Fast(PyTuple_GetItem(args, 2), "handles must be a sequence");
+  if (!handles || PySequence_Fast_GET_SIZE(handles) != n) {
+    if (handles)
+      PyErr_SetString(PyExc_ValueError, "need one handle per env id");
+    Py_XDECREF(handles);
+    free(ids);
+    return NULL;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  vec_wait_all(vec);
+  Py_END_ALLOW_THREADS
 
-    PyObject *pos = Py_BuildValue("(iii)", env->gstate.ram.x, env->gstate.ram.y,
-                                  env->gstate.ram.map_n);
-    PyList_SetItem(list, i, pos);
+  int failed = -1;
+  for (Py_ssize_t i = 0; i < n; i++) {
+    int64_t handle = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(handles, i));
+    const Snapshot *snap = snapshot_get(&g_snapshots, handle);
+    if (!snap) {
+      if (!PyErr_Occurred())
+        PyErr_Format(PyExc_KeyError, "unknown snapshot handle %lld",
+                     (long long)handle);
+      break;
+    }
+    if (!c_restore(vec->envs[ids[i]], &g_snapshots, snap)) {
+      failed = ids[i];
+      break;
+    }
   }
-  return list;
+  if (failed >= 0)
+    PyErr_Format(PyExc_RuntimeError, "failed to restore env %d", failed);
+  Py_DECREF(handles);
+  free(ids);
+  if (PyErr_Occurred())
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+static PyObject *vec_release(PyObject *self, PyObject *args) {
+  if (PyTuple_Size(args) != 1) {
+    PyErr_SetString(PyExc_TypeError, "vec_release requires 1 argument");
+    return NULL;
+  }
+  PyObject *handles =
+      PySequence_Fast(PyTuple_GetItem(args, 0), "handles must be a sequence");
+  if (!handles)
+    return NULL;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(handles);
+  for (Py_ssize_t i = 0; i < n; i++) {
+    int64_t handle = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(handles, i));
+    if (PyErr_Occurred())
+      break;
+    // Releasing twice is harmless; the generation check ignores it
+    snapshot_release(&g_snapshots, handle);
+  }
+  Py_DECREF(handles);
+  if (PyErr_Occurred())
+    return NULL;
+  if (g_snapshots.num_live == 0)
+    snapshot_arena_free(&g_snapshots);
+  Py_RETURN_NONE;
+}
+
+// Registers a C-contiguous int16 array of shape (num_envs, TELEMETRY_FIELDS)
+// that every step overwrites in place, so streaming reads positions without
+// building Python objects. Like the obs buffers, the caller keeps it alive;
+// None unregisters it and steps stop writing.
+static PyObject *vec_telemetry_init(PyObject *self, PyObject *args) {
+  if (PyTuple_Size(args) != 2) {
+    PyErr_SetString(PyExc_TypeError, "vec_telemetry_init requires 2 arguments");
+    return NULL;
+  }
+  VecEnv *vec = unpack_vecenv(args);
+  if (!vec)
+    return NULL;
+  PyObject *arr_obj = PyTuple_GetItem(args, 1);
+  // Steps in flight write through the pointers being swapped
+  Py_BEGIN_ALLOW_THREADS
+  vec_wait_all(vec);
+  Py_END_ALLOW_THREADS
+  if (arr_obj == Py_None) {
+    for (int i = 0; i < vec->num_envs; i++)
+      vec->envs[i]->telemetry = NULL;
+    Py_RETURN_NONE;
+  }
+  if (!PyObject_TypeCheck(arr_obj, &PyArray_Type)) {
+    PyErr_SetString(PyExc_TypeError, "telemetry must be a NumPy array");
+    return NULL;
+  }
+  PyArrayObject *arr = (PyArrayObject *)arr_obj;
+  if (!PyArray_ISCARRAY(arr) || PyArray_TYPE(arr) != NPY_INT16 ||
+      PyArray_NDIM(arr) != 2 || PyArray_DIM(arr, 0) != vec->num_envs ||
+      PyArray_DIM(arr, 1) != TELEMETRY_FIELDS) {
+    PyErr_Format(PyExc_ValueError,
+                 "telemetry must be a writable C-contiguous int16 array of "
+                 "shape (%d, %d)",
+                 vec->num_envs, TELEMETRY_FIELDS);
+    return NULL;
+  }
+  int16_t *data = (int16_t *)PyArray_DATA(arr);
+  for (int i = 0; i < vec->num_envs; i++)
+    vec->envs[i]->telemetry = data + (size_t)i * TELEMETRY_FIELDS;
+  Py_RETURN_NONE;
+}
+
+static void visit_map_capsule_free(PyObject *capsule) {
+  visitmap_close((VisitMap *)PyCapsule_GetPointer(capsule, "pokered.VisitMap"));
+}
+
+// uint32 array over the mapping; its base holds a visit map reference, so
+// the pages stay mapped while any view (or a slice of one) is alive
+static PyObject *visit_map_view(VisitMap *vm, void *data, int ndim,
+                                npy_intp *dims) {
+  PyObject *arr = PyArray_SimpleNewFromData(ndim, dims, NPY_UINT32, data);
+  if (!arr)
+    return NULL;
+  PyObject *owner = PyCapsule_New(visitmap_retain(vm), "pokered.VisitMap",
+                                  visit_map_capsule_free);
+  if (!owner) {
+    visitmap_close(vm);
+    Py_DECREF(arr);
+    return NULL;
+  }
+  // Steals owner, on failure too
+  if (PyArray_SetBaseObject((PyArrayObject *)arr, owner) < 0) {
+    Py_DECREF(arr);
+    return NULL;
+  }
+  return arr;
+}
+
+// Zero-copy (directory, counts) arrays over the shm visit map, valid for as
+// long as they are referenced, vec_close included
+static PyObject *vec_visit_map(PyObject *self, PyObject *args) {
+  VecEnv *vec = unpack_vecenv(args);
+  if (!vec)
+    return NULL;
+  VisitMap *vm = vec->num_envs > 0 ? vec->envs[0]->visit_map : NULL;
+  if (!vm)
+    Py_RETURN_NONE;
+  npy_intp directory_dims[1] = {VISITMAP_DIRECTORY};
+  npy_intp counts_dims[3] = {(npy_intp)vm->header->capacity, VISITMAP_BLOCK_DIM,
+                             VISITMAP_BLOCK_DIM};
+  PyObject *directory =
+      visit_map_view(vm, (void *)vm->directory, 1, directory_dims);
+  PyObject *counts = visit_map_view(vm, (void *)vm->counts, 3, counts_dims);
+  if (!directory || !counts) {
+    Py_XDECREF(directory);
+    Py_XDECREF(counts);
+    return NULL;
+  }
+  return Py_BuildValue("(NN)", directory, counts);
 }
 
 static int my_init(Env *env, PyObject *args, PyObject *kwargs) {
   const char *rom_path = NULL;
-  g_env_init_counter++;
+  env->env_id = g_env_init_counter++;
   env->emu.frame_skip = unpack(kwargs, "frameskip");
   env->max_episode_length = unpack(kwargs, "max_episode_length");
   env->emu.render_enabled = !unpack(kwargs, "headless");
   env->full_reset = unpack(kwargs, "full_reset");
+  env->adaptive_frameskip = unpack(kwargs, "adaptive_frameskip");
+  env->max_frameskip = unpack(kwargs, "max_frameskip");
+  env->macro_actions = unpack(kwargs, "macro_actions");
+  env->lazy_render = unpack(kwargs, "lazy_render");
+  env->fast_options = unpack(kwargs, "fast_options");
+  env->instant_text = unpack(kwargs, "instant_text");
+  env->obs_mode = unpack(kwargs, "obs_mode");
+#define UNPACK_WEIGHT(NAME, name, bit, weight)                                 \
+  env->reward_weights.name = unpack(kwargs, "reward_" #name);
+  REWARD_COMPONENTS(UNPACK_WEIGHT)
+#undef UNPACK_WEIGHT
+  env->event_scan_interval = unpack(kwargs, "event_scan_interval");
+  uint32_t components = REWARD_ALL;
+  PyObject *components_obj = PyDict_GetItemString(kwargs, "reward_components");
+  if (components_obj && components_obj != Py_None) {
+    const char *list = PyUnicode_AsUTF8(components_obj);
+    if (!list)
+      return -1;
+    if (!parse_reward_components(list, &components)) {
+      PyErr_Format(PyExc_ValueError, "unknown reward component in: %s", list);
+      return -1;
+    }
+  }
+  select_rewards(env, components);
+  if (env->obs_mode < 0 || env->obs_mode >= OBS_MODE_COUNT) {
+    PyErr_Format(PyExc_ValueError, "invalid obs_mode: %d", env->obs_mode);
+    return -1;
+  }
 
   PyObject *state_path_obj = PyDict_GetItemString(kwargs, "state_path");
   if (state_path_obj && state_path_obj != Py_None) {
@@ -64,21 +350,236 @@ static int my_init(Env *env, PyObject *args, PyObject *kwargs) {
   }
   fclose(rom_file);
 
-  mgba_init_core(&env->emu, rom_path);
-  env->visited_coords = (uint8_t *)calloc(VISITED_COORDS_SIZE, sizeof(uint8_t));
-  env->prev_visited_coords =
-      (uint8_t *)calloc(VISITED_COORDS_SIZE, sizeof(uint8_t));
-  memset(env->prev_visited_coords, 1, VISITED_COORDS_SIZE);
-  env->unique_coords_count = 0;
-  env->prev_events = (uint8_t *)calloc(EVENT_COUNT, sizeof(uint8_t));
-  memset(env->prev_events, 0, EVENT_COUNT);
-  printf("Initialized environment #%d with ROM: %s\n", g_env_init_counter,
-         rom_path);
-  if (!env->emu.core) {
-    PyErr_SetString(PyExc_RuntimeError, "Failed to initialize mGBA core");
+  int archive_cells = unpack(kwargs, "archive_cells");
+  env->archive_reset_prob = unpack(kwargs, "archive_reset_prob");
+  env->archive_alpha = unpack(kwargs, "archive_alpha");
+  PyObject *archive_name_obj = PyDict_GetItemString(kwargs, "archive_name");
+  if (archive_cells > 0) {
+    if (!archive_name_obj || !PyUnicode_Check(archive_name_obj)) {
+      PyErr_SetString(PyExc_ValueError, "archive_cells needs an archive_name");
+      return -1;
+    }
+    const char *archive_name = PyUnicode_AsUTF8(archive_name_obj);
+    if (strlen(archive_name) >= sizeof(g_archive_name) ||
+        strchr(archive_name, '/')) {
+      PyErr_Format(PyExc_ValueError, "invalid archive_name: %s", archive_name);
+      return -1;
+    }
+    strcpy(g_archive_name, archive_name);
+  }
+  g_archive_cells = archive_cells > 0 ? (uint32_t)archive_cells : 0;
+
+  int visit_map_blocks = unpack(kwargs, "visit_map_blocks");
+  env->novelty_scale = unpack(kwargs, "novelty_scale");
+  if (visit_map_blocks > 0) {
+    PyObject *name_obj = PyDict_GetItemString(kwargs, "visit_map_name");
+    if (!name_obj || !PyUnicode_Check(name_obj)) {
+      PyErr_SetString(PyExc_ValueError,
+                      "visit_map_blocks needs a visit_map_name");
+      return -1;
+    }
+    const char *name = PyUnicode_AsUTF8(name_obj);
+    if (strlen(name) >= sizeof(g_visitmap_name) || strchr(name, '/')) {
+      PyErr_Format(PyExc_ValueError, "invalid visit_map_name: %s", name);
+      return -1;
+    }
+    strcpy(g_visitmap_name, name);
+  }
+  g_visitmap_blocks = visit_map_blocks > 0 ? (uint32_t)visit_map_blocks : 0;
+
+  int record_keyframes = unpack(kwargs, "record_keyframe_interval");
+  g_record_keyframes = record_keyframes > 0 ? (uint32_t)record_keyframes : 0;
+  g_record_dir[0] = '\0';
+  PyObject *record_dir_obj = PyDict_GetItemString(kwargs, "record_dir");
+  if (record_dir_obj && record_dir_obj != Py_None) {
+    const char *record_dir = PyUnicode_AsUTF8(record_dir_obj);
+    if (!record_dir)
+      return -1;
+    if (strlen(record_dir) >= sizeof(g_record_dir)) {
+      PyErr_Format(PyExc_ValueError, "record_dir too long: %s", record_dir);
+      return -1;
+    }
+    strcpy(g_record_dir, record_dir);
+  }
+
+  // Decoded start states go through shm when the workers share a run id
+  PyObject *state_cache_obj = PyDict_GetItemString(kwargs, "state_cache_name");
+  const char *state_cache_name = "";
+  if (state_cache_obj && state_cache_obj != Py_None) {
+    state_cache_name = PyUnicode_AsUTF8(state_cache_obj);
+    if (!state_cache_name)
+      return -1;
+    if (strlen(state_cache_name) >= sizeof(g_state_cache_name) ||
+        strchr(state_cache_name, '/')) {
+      PyErr_Format(PyExc_ValueError, "invalid state_cache_name: %s",
+                   state_cache_name);
+      return -1;
+    }
+  }
+  mgba_share_state_cache(state_cache_name);
+
+  g_env_arenas = unpack(kwargs, "env_arenas");
+  g_huge_pages = unpack(kwargs, "huge_pages");
+
+  PyObject *clone_obj = PyDict_GetItemString(kwargs, "clone_from_template");
+  env->clone_from_template = clone_obj && PyObject_IsTrue(clone_obj) == 1;
+  if (env->env_id == 0)
+    printf("Initializing environments with ROM: %s\n", rom_path);
+  return 0;
+}
+
+// Moves the env into an arena mapped on this thread, the one that will step
+// it when threads are pinned; my_init_native then fills it from here
+static Env *my_place_env(Env *env) {
+  EnvArena arena;
+  if (!g_env_arenas || !arena_map(&arena, ENV_ARENA_BYTES, g_huge_pages))
+    return env;
+  if (g_huge_pages && !arena.huge && env->env_id == 0)
+    fprintf(stderr, "Transparent huge pages unavailable, using 4 KiB pages\n");
+  Env *placed = (Env *)arena_alloc(&arena, sizeof(Env));
+  if (!placed) {
+    arena_unmap(arena);
+    return env;
+  }
+  memcpy(placed, env, sizeof(Env));
+  placed->arena = arena;
+  free(env);
+  return placed;
+}
+static void my_free_env(Env *env) {
+  EnvArena arena = env->arena;
+  if (arena_owns(&arena, env))
+    arena_unmap(arena);
+  else
+    free(env);
+}
+
+// Runs on an init thread without the GIL: core setup, state decode, buffers
+static int my_init_native(Env *env) {
+  if (pokered_init_env(env) != 0)
     return -1;
+  if (g_archive_cells > 0) {
+    size_t state_size = savestate_size(env->emu.core);
+    env->archive_buf = (uint8_t *)env_alloc(env, state_size);
+    if (env->archive_buf)
+      env->archive = archive_open(g_archive_name, g_archive_cells, state_size);
+    if (!env->archive && env->env_id == 0)
+      fprintf(stderr, "Frontier archive /%s unavailable, resetting from %s\n",
+              g_archive_name, env->emu.state_path);
   }
+  if (g_visitmap_blocks > 0) {
+    env->visit_map = visitmap_open(g_visitmap_name, g_visitmap_blocks);
+    if (!env->visit_map && env->env_id == 0)
+      fprintf(stderr, "Visit map /%s unavailable, novelty disabled\n",
+              g_visitmap_name);
+  }
+  if (g_record_dir[0]) {
+    // Worker processes share the directory, so the pid keeps names unique
+    char path[sizeof(g_record_dir) + 48];
+    snprintf(path, sizeof(path), "%s/pokered_%d_%d.prr", g_record_dir,
+             (int)getpid(), env->env_id);
+    if (!c_record_open(env, path, g_record_keyframes))
+      fprintf(stderr, "Could not record env %d to %s\n", env->env_id, path);
+  }
+  return 0;
+}
+
+// Adds to a float already in the dict (events from several envs share keys)
+static int add_to_dict(PyObject *dict, const char *key, float value) {
+  PyObject *prev = PyDict_GetItemString(dict, key);
+  if (prev)
+    value += (float)PyFloat_AsDouble(prev);
+  return assign_to_dict(dict, (char *)key, value);
+}
 
+#ifdef ENABLE_PERF_COUNTERS
+// Mean per-step phase cost, step latency percentiles and throughput since the
+// last vec_log, summed over the logged envs
+static void log_perf(PyObject *dict, Env **envs, int num_envs) {
+  PerfCounters total = {0};
+  for (int i = 0; i < num_envs; i++) {
+    PerfCounters *perf = &envs[i]->perf;
+    for (int p = 0; p < PERF_PHASE_COUNT; p++)
+      total.phase_ns[p] += perf->phase_ns[p];
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+      total.hist[b] += perf->hist[b];
+    total.step_ns += perf->step_ns;
+    total.steps += perf->steps;
+    total.frames += perf->frames;
+    memset(perf, 0, sizeof(*perf));
+  }
+  if (total.steps == 0)
+    return;
+  char key[64];
+  double steps = (double)total.steps;
+  for (int p = 0; p < PERF_PHASE_COUNT; p++) {
+    snprintf(key, sizeof(key), "perf/%s_us", PERF_PHASE_NAMES[p]);
+    assign_to_dict(dict, key, (float)(total.phase_ns[p] / steps / 1e3));
+  }
+  assign_to_dict(dict, "perf/step_us", (float)(total.step_ns / steps / 1e3));
+  assign_to_dict(dict, "perf/step_p50_us",
+                 (float)(perf_percentile_ns(total.hist, total.steps, 0.50) / 1e3));
+  assign_to_dict(dict, "perf/step_p90_us",
+                 (float)(perf_percentile_ns(total.hist, total.steps, 0.90) / 1e3));
+  assign_to_dict(dict, "perf/step_p99_us",
+                 (float)(perf_percentile_ns(total.hist, total.steps, 0.99) / 1e3));
+  // Per env thread: time spent inside c_step only
+  double step_s = (double)total.step_ns / 1e9;
+  assign_to_dict(dict, "perf/frames_per_sec", (float)(total.frames / step_s));
+  assign_to_dict(dict, "perf/steps_per_sec", (float)(steps / step_s));
+  assign_to_dict(dict, "perf/reset_share",
+                 (float)((double)total.phase_ns[PERF_RESET] / total.step_ns));
+}
+#endif
+
+// Drains every env's milestone ring: per-kind counts and mean step, plus a
+// count per completed event name
+static int my_vec_log(PyObject *dict, Env **envs, int num_envs) {
+  float counts[MILESTONE_KIND_COUNT] = {0};
+  float steps[MILESTONE_KIND_COUNT] = {0};
+  float dropped = 0.0f;
+  float archive_resets = 0.0f;
+  char key[128];
+  for (int i = 0; i < num_envs; i++) {
+    MilestoneRing *ring = &envs[i]->milestones;
+    Milestone m;
+    while (milestone_pop(ring, &m)) {
+      counts[m.kind] += 1.0f;
+      steps[m.kind] += (float)m.step;
+      if (m.kind == MILESTONE_EVENT && m.value < EVENT_COUNT) {
+        snprintf(key, sizeof(key), "events/%s", EVENT_LIST[m.value].name);
+        if (add_to_dict(dict, key, 1.0f))
+          return -1;
+      }
+    }
+    dropped += (float)milestone_take_dropped(ring);
+    archive_resets += (float)envs[i]->archive_resets;
+    envs[i]->archive_resets = 0;
+  }
+  for (int k = 0; k < MILESTONE_KIND_COUNT; k++) {
+    if (counts[k] == 0.0f)
+      continue;
+    snprintf(key, sizeof(key), "milestones/%s", MILESTONE_NAMES[k]);
+    assign_to_dict(dict, key, counts[k]);
+    snprintf(key, sizeof(key), "milestones/%s_step", MILESTONE_NAMES[k]);
+    assign_to_dict(dict, key, steps[k] / counts[k]);
+  }
+  if (dropped > 0.0f)
+    assign_to_dict(dict, "milestones/dropped", dropped);
+  if (num_envs > 0 && envs[0]->archive) {
+    assign_to_dict(dict, "archive/cells",
+                   (float)atomic_load(&envs[0]->archive->header->count));
+    assign_to_dict(dict, "archive/resets", archive_resets);
+  }
+  if (num_envs > 0 && envs[0]->visit_map) {
+    VisitMap *vm = envs[0]->visit_map;
+    assign_to_dict(dict, "visits/blocks", (float)visitmap_blocks_used(vm));
+    assign_to_dict(dict, "visits/dropped",
+                   (float)atomic_load(&vm->header->dropped));
+  }
+#ifdef ENABLE_PERF_COUNTERS
+  log_perf(dict, envs, num_envs);
+#endif
   return 0;
 }
 
@@ -97,6 +598,7 @@ static int my_log(PyObject *dict, Log *log) {
   assign_to_dict(dict, "pkmn5_lvl", log->pkmn5_lvl);
   assign_to_dict(dict, "badges", log->badges);
   assign_to_dict(dict, "pkmn6_lvl", log->pkmn6_lvl);
+  assign_to_dict(dict, "frames_per_step", log->frames_per_step);
   assign_to_dict(dict, "n", log->n);
   return 0;
 }
@@ -0,0 +1,250 @@
+// archive.h - Frontier savestate archive shared by every worker process
+// A fixed-capacity open-addressing table of cells keyed by (map, badges,
+// event_sum), each holding one savestate, lives in a named POSIX shm segment.
+// Envs offer a state whenever they enter a cell; a cell keeps the state that
+// reached it in the fewest steps from the original start. Resets can then
+// sample a cell, weighted by (times chosen + 1)^-alpha, instead of replaying
+// the early game from state_path.
+//
+// Everything in the segment is accessed through atomics: cells are claimed
+// by CAS on the key, and each state blob is guarded by a seqlock (writers
+// CAS the sequence odd and skip if someone else holds it, readers retry).
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <math.h>
+#include <mgba/core/core.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "savestate.h"
+#include "shm.h"
+
+#define ARCHIVE_MAGIC 0x50524641u // "PRFA"
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_MAX_PROBE 32
+#define ARCHIVE_READ_RETRIES 8
+
+typedef struct {
+  ShmHeader shm;
+  uint32_t capacity; // power of two
+  uint32_t state_size;
+  _Atomic uint32_t count; // claimed cells
+} ArchiveHeader;
+
+typedef struct {
+  _Atomic uint32_t key; // archive_key() + 1, 0 = empty
+  _Atomic uint32_t seq; // seqlock over the blob, odd while writing
+  _Atomic uint32_t best_steps; // steps from state_path, valid once stored
+  _Atomic uint32_t chosen;     // times handed out by archive_sample
+  _Atomic uint32_t seen;       // times an env entered the cell
+  _Atomic uint32_t stored;     // non-zero once a state has been written
+} ArchiveCell;
+
+typedef struct {
+  ShmSegment segment;
+  ArchiveHeader *header;
+  ArchiveCell *cells;
+  uint8_t *blobs; // capacity * state_size
+} FrontierArchive;
+
+static FrontierArchive g_archive;
+static pthread_mutex_t g_archive_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t archive_key(uint8_t map_n, uint8_t badges,
+                                   uint32_t event_sum) {
+  return (uint32_t)map_n << 24 | (uint32_t)badges << 16 | (event_sum & 0xFFFF);
+}
+static inline uint32_t archive_hash(uint32_t key) {
+  key ^= key >> 16;
+  key *= 0x85EBCA6Bu;
+  key ^= key >> 13;
+  key *= 0xC2B2AE35u;
+  key ^= key >> 16;
+  return key;
+}
+// xorshift32 in [0, 1), per-env state so resets need no shared RNG
+static inline float archive_rand01(uint32_t *state) {
+  uint32_t x = *state ? *state : 0x9E3779B9u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return (float)(x >> 8) / 16777216.0f;
+}
+static inline size_t archive_map_size(uint32_t capacity, size_t state_size) {
+  return sizeof(ArchiveHeader) + capacity * sizeof(ArchiveCell) +
+         capacity * state_size;
+}
+static inline uint8_t *archive_blob(const FrontierArchive *archive,
+                                    uint32_t index) {
+  return archive->blobs + (size_t)index * archive->header->state_size;
+}
+
+typedef struct {
+  uint32_t capacity;
+  uint32_t state_size;
+} ArchiveLayout;
+static void archive_init_header(void *base, const void *arg) {
+  const ArchiveLayout *layout = (const ArchiveLayout *)arg;
+  ArchiveHeader *header = (ArchiveHeader *)base;
+  header->capacity = layout->capacity;
+  header->state_size = layout->state_size;
+}
+static bool archive_match_header(const void *base, const void *arg) {
+  const ArchiveLayout *layout = (const ArchiveLayout *)arg;
+  const ArchiveHeader *header = (const ArchiveHeader *)base;
+  return header->capacity == layout->capacity &&
+         header->state_size == layout->state_size;
+}
+
+// Creates or joins the segment `name`; capacity is rounded up to a power of
+// two. Returns NULL (and the caller runs without an archive) if the segment
+// cannot be mapped or an existing one has a different layout.
+static FrontierArchive *archive_open(const char *name, uint32_t capacity,
+                                     size_t state_size) {
+  uint32_t cap = 1;
+  while (cap < capacity)
+    cap <<= 1;
+  ArchiveLayout layout = {cap, (uint32_t)state_size};
+
+  pthread_mutex_lock(&g_archive_lock);
+  FrontierArchive *archive = &g_archive;
+  bool ok = shm_segment_open(&archive->segment, name,
+                             archive_map_size(cap, state_size), ARCHIVE_MAGIC,
+                             ARCHIVE_VERSION, archive_init_header,
+                             archive_match_header, &layout);
+  if (ok && archive->segment.users == 1) {
+    archive->header = (ArchiveHeader *)archive->segment.base;
+    archive->cells = (ArchiveCell *)(archive->header + 1);
+    archive->blobs = (uint8_t *)(archive->cells + cap);
+  }
+  pthread_mutex_unlock(&g_archive_lock);
+  return ok ? archive : NULL;
+}
+
+static void archive_close(FrontierArchive *archive) {
+  if (!archive)
+    return;
+  pthread_mutex_lock(&g_archive_lock);
+  if (shm_segment_close(&archive->segment)) {
+    archive->header = NULL;
+    archive->cells = NULL;
+    archive->blobs = NULL;
+  }
+  pthread_mutex_unlock(&g_archive_lock);
+}
+
+// Index of the cell for key, claiming an empty one if needed; -1 when the
+// probe window is full or the table is at 3/4 load
+static inline int archive_find_or_claim(FrontierArchive *archive,
+                                        uint32_t key) {
+  ArchiveHeader *header = archive->header;
+  uint32_t mask = header->capacity - 1;
+  uint32_t stored_key = key + 1;
+  uint32_t index = archive_hash(key) & mask;
+  for (int probe = 0; probe < ARCHIVE_MAX_PROBE; probe++) {
+    ArchiveCell *cell = &archive->cells[index];
+    uint32_t current = atomic_load_explicit(&cell->key, memory_order_acquire);
+    if (current == stored_key)
+      return (int)index;
+    if (current == 0) {
+      if (atomic_load_explicit(&header->count, memory_order_relaxed) >=
+          header->capacity / 4 * 3)
+        return -1;
+      uint32_t expected = 0;
+      if (atomic_compare_exchange_strong(&cell->key, &expected, stored_key)) {
+        atomic_fetch_add_explicit(&header->count, 1, memory_order_relaxed);
+        return (int)index;
+      }
+      if (expected == stored_key)
+        return (int)index;
+    }
+    index = (index + 1) & mask;
+  }
+  return -1;
+}
+
+// Writer side of the seqlock: save into the blob if nobody else is writing
+// and the offered state reached the cell in fewer steps
+static inline bool archive_offer(FrontierArchive *archive, uint32_t key,
+                                 uint32_t steps, struct mCore *core) {
+  int index = archive_find_or_claim(archive, key);
+  if (index < 0)
+    return false;
+  ArchiveCell *cell = &archive->cells[index];
+  atomic_fetch_add_explicit(&cell->seen, 1, memory_order_relaxed);
+  if (atomic_load_explicit(&cell->stored, memory_order_acquire) &&
+      steps >= atomic_load_explicit(&cell->best_steps, memory_order_relaxed))
+    return false;
+  uint32_t seq = atomic_load_explicit(&cell->seq, memory_order_relaxed);
+  if ((seq & 1) ||
+      !atomic_compare_exchange_strong_explicit(&cell->seq, &seq, seq + 1,
+                                               memory_order_acquire,
+                                               memory_order_relaxed))
+    return false;
+  bool saved = savestate_save(core, archive_blob(archive, (uint32_t)index));
+  if (saved) {
+    atomic_store_explicit(&cell->best_steps, steps, memory_order_relaxed);
+    atomic_store_explicit(&cell->stored, 1, memory_order_release);
+  }
+  atomic_store_explicit(&cell->seq, seq + 2, memory_order_release);
+  return saved;
+}
+
+// Picks a stored cell with weight (chosen + 1)^-alpha (alpha = 0 is uniform)
+static inline int archive_sample(FrontierArchive *archive, float alpha,
+                                 float u) {
+  uint32_t capacity = archive->header->capacity;
+  double total = 0.0;
+  for (uint32_t i = 0; i < capacity; i++) {
+    ArchiveCell *cell = &archive->cells[i];
+    if (atomic_load_explicit(&cell->stored, memory_order_acquire))
+      total += powf(
+          (float)atomic_load_explicit(&cell->chosen, memory_order_relaxed) + 1,
+          -alpha);
+  }
+  if (total <= 0.0)
+    return -1;
+  double target = u * total;
+  int last = -1;
+  for (uint32_t i = 0; i < capacity; i++) {
+    ArchiveCell *cell = &archive->cells[i];
+    if (!atomic_load_explicit(&cell->stored, memory_order_acquire))
+      continue;
+    last = (int)i;
+    target -= powf(
+        (float)atomic_load_explicit(&cell->chosen, memory_order_relaxed) + 1,
+        -alpha);
+    if (target <= 0.0)
+      break;
+  }
+  if (last >= 0)
+    atomic_fetch_add_explicit(&archive->cells[last].chosen, 1,
+                              memory_order_relaxed);
+  return last;
+}
+
+// Reader side of the seqlock: copies a consistent blob into dst
+static inline bool archive_read(FrontierArchive *archive, int index,
+                                void *dst, uint32_t *best_steps) {
+  ArchiveCell *cell = &archive->cells[index];
+  for (int attempt = 0; attempt < ARCHIVE_READ_RETRIES; attempt++) {
+    uint32_t before = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    if (before & 1)
+      continue;
+    memcpy(dst, archive_blob(archive, (uint32_t)index),
+           archive->header->state_size);
+    *best_steps = atomic_load_explicit(&cell->best_steps, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&cell->seq, memory_order_relaxed) == before)
+      return true;
+  }
+  return false;
+}
+
+#endif // ARCHIVE_H
@@ -0,0 +1,114 @@
+// arena.h - Per-env memory arena, first-touched on the env's stepping thread
+// One 2 MiB-aligned anonymous mapping per env holds the env struct and the
+// per-env buffers it owns (video buffer, archive scratch, event bytes), so
+// they share one TLB entry when backed by a transparent huge page. The
+// mapping prefers the NUMA node of the CPU that creates it; env_binding
+// creates it on the (pinned) thread that will step the env, and zeroing each
+// allocation there is the first touch, so the pages land on that node.
+// Allocation is a bump pointer; nothing is freed before the whole arena.
+// The mapping comes straight from mmap rather than aligned_malloc: a heap
+// block may reuse pages some other thread already touched, on another node.
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ARENA_HUGE_PAGE (2u << 20)
+#define ARENA_ALIGN 64
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1 // <numaif.h>, without needing libnuma
+#endif
+
+typedef struct {
+  uint8_t *base;
+  size_t size;
+  size_t used;
+  bool huge; // MADV_HUGEPAGE accepted
+  int node;  // preferred NUMA node, -1 if the kernel has no NUMA policy
+} EnvArena;
+
+// NUMA node of the CPU this thread is running on, -1 if unknown
+static inline int arena_current_node(void) {
+#ifdef SYS_getcpu
+  unsigned int cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+    return (int)node;
+#endif
+  return -1;
+}
+
+// Maps `size` bytes (rounded up to whole 2 MiB pages, on a 2 MiB boundary)
+// and prefers the calling thread's node. Preferred, not bound: a full node
+// spills to its neighbours instead of failing the page fault.
+static bool arena_map(EnvArena *arena, size_t size, bool huge) {
+  memset(arena, 0, sizeof(*arena));
+  arena->node = -1;
+  size = (size + ARENA_HUGE_PAGE - 1) & ~(size_t)(ARENA_HUGE_PAGE - 1);
+  // Over-map by one huge page and trim, so the arena is hugepage-aligned
+  size_t span = size + ARENA_HUGE_PAGE;
+  uint8_t *map = (uint8_t *)mmap(NULL, span, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    return false;
+  uintptr_t start = ((uintptr_t)map + ARENA_HUGE_PAGE - 1) &
+                    ~(uintptr_t)(ARENA_HUGE_PAGE - 1);
+  uint8_t *base = (uint8_t *)start;
+  if (base > map)
+    munmap(map, (size_t)(base - map));
+  if (base + size < map + span)
+    munmap(base + size, (size_t)(map + span - (base + size)));
+  arena->base = base;
+  arena->size = size;
+#ifdef MADV_HUGEPAGE
+  arena->huge = huge && madvise(base, size, MADV_HUGEPAGE) == 0;
+#endif
+#ifdef SYS_mbind
+  int node = arena_current_node();
+  if (node >= 0 && node < 64) {
+    unsigned long mask = 1ul << node;
+    if (syscall(SYS_mbind, base, size, MPOL_PREFERRED, &mask,
+                sizeof(mask) * 8, 0) == 0)
+      arena->node = node;
+  }
+#endif
+  return true;
+}
+
+// Zeroed, ARENA_ALIGN-aligned block; NULL once the arena is full so callers
+// can fall back to the heap
+static inline void *arena_alloc(EnvArena *arena, size_t size) {
+  if (!arena->base)
+    return NULL;
+  size_t offset = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (offset + size > arena->size)
+    return NULL;
+  arena->used = offset + size;
+  void *ptr = arena->base + offset;
+  memset(ptr, 0, size); // first touch, on the calling thread's node
+  return ptr;
+}
+
+static inline bool arena_owns(const EnvArena *arena, const void *ptr) {
+  const uint8_t *p = (const uint8_t *)ptr;
+  return arena->base && p >= arena->base && p < arena->base + arena->size;
+}
+
+// Frees ptr unless it lives in the arena
+static inline void arena_free(const EnvArena *arena, void *ptr) {
+  if (!arena_owns(arena, ptr))
+    free(ptr);
+}
+
+// The arena may hold the struct passed in, so the caller copies it first
+static inline void arena_unmap(EnvArena arena) {
+  if (arena.base)
+    munmap(arena.base, arena.size);
+}
+
+#endif // ARENA_H
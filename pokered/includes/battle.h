@@ -50,25 +50,26 @@ typedef struct {
   bool battle_active;    // Whether currently in an active battle
 } BattleState;
 
+// All reads come from the WRAM snapshot taken at the start of the step
 // Read battle flag (-1=lost, 0=none, 1=wild, 2=trainer)
 static inline int8_t read_battle_flag(mGBA *emu) {
-  return (int8_t)read_mem(emu, BATTLE_FLAG_ADDR);
+  return (int8_t)read_wram(emu, BATTLE_FLAG_ADDR);
 }
 // Read battle type (0=normal, 1=old man, 2=safari)
 static inline uint8_t read_battle_type(mGBA *emu) {
-  return read_mem(emu, BATTLE_TYPE_ADDR);
+  return read_wram(emu, BATTLE_TYPE_ADDR);
 }
 // Check if gym battle music is playing
 static inline bool is_gym_battle(mGBA *emu) {
-  return read_mem(emu, GYM_BATTLE_MUSIC_ADDR) != 0;
+  return read_wram(emu, GYM_BATTLE_MUSIC_ADDR) != 0;
 }
 // Read current turn count in battle
 static inline uint8_t read_turn_count(mGBA *emu) {
-  return read_mem(emu, TURN_COUNT_ADDR);
+  return read_wram(emu, TURN_COUNT_ADDR);
 }
 // Read party count
 static inline uint8_t read_party_count(mGBA *emu) {
-  return read_mem(emu, PARTY_COUNT_ADDR);
+  return read_wram(emu, PARTY_COUNT_ADDR);
 }
 static inline void update_battle_state(BattleState *battle, mGBA *emu) {
   battle->in_battle = read_battle_flag(emu);
@@ -0,0 +1,155 @@
+// Generated by scripts/gen_event_masks.py from events.h - do not edit
+#ifndef EVENT_MASKS_H
+#define EVENT_MASKS_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint16_t address;
+  uint8_t mask; // EVENT_LIST bits tracked at this address
+} EventMask;
+
+#define EVENT_MASK_COUNT 137
+#define EVENT_MASK_BITS 501 // == EVENT_COUNT
+
+static const EventMask EVENT_MASKS[EVENT_MASK_COUNT] = {
+    {0xD747, 0x49},
+    {0xD74A, 0x07},
+    {0xD74B, 0xFF},
+    {0xD74C, 0x03},
+    {0xD74E, 0x03},
+    {0xD751, 0xFF},
+    {0xD752, 0x03},
+    {0xD754, 0x02},
+    {0xD755, 0xC4},
+    {0xD75A, 0x01},
+    {0xD75B, 0x80},
+    {0xD75E, 0xCC},
+    {0xD75F, 0x01},
+    {0xD764, 0xC0},
+    {0xD765, 0x0E},
+    {0xD766, 0x0E},
+    {0xD767, 0xBC},
+    {0xD768, 0x8E},
+    {0xD769, 0x8E},
+    {0xD76C, 0x01},
+    {0xD771, 0xC2},
+    {0xD773, 0xDF},
+    {0xD777, 0x01},
+    {0xD778, 0xF0},
+    {0xD77C, 0xFF},
+    {0xD77D, 0x01},
+    {0xD77E, 0x1E},
+    {0xD783, 0x01},
+    {0xD78E, 0x03},
+    {0xD790, 0xC0},
+    {0xD792, 0xFF},
+    {0xD796, 0x01},
+    {0xD798, 0x02},
+    {0xD79A, 0xFF},
+    {0xD79B, 0x01},
+    {0xD79C, 0x7F},
+    {0xD7A1, 0x80},
+    {0xD7A3, 0x07},
+    {0xD7AF, 0x01},
+    {0xD7B1, 0xFF},
+    {0xD7B3, 0xFF},
+    {0xD7B4, 0x01},
+    {0xD7B9, 0x80},
+    {0xD7BD, 0x01},
+    {0xD7BF, 0x01},
+    {0xD7C2, 0x01},
+    {0xD7C3, 0xFC},
+    {0xD7C4, 0x03},
+    {0xD7C5, 0x04},
+    {0xD7C6, 0x80},
+    {0xD7C9, 0x7E},
+    {0xD7CD, 0xFE},
+    {0xD7CE, 0x03},
+    {0xD7CF, 0xFE},
+    {0xD7D0, 0x03},
+    {0xD7D1, 0x7E},
+    {0xD7D2, 0xFE},
+    {0xD7D3, 0xFE},
+    {0xD7D4, 0x03},
+    {0xD7D5, 0xFE},
+    {0xD7D6, 0x87},
+    {0xD7D7, 0xFD},
+    {0xD7D8, 0xC1},
+    {0xD7D9, 0xFE},
+    {0xD7DA, 0x07},
+    {0xD7DB, 0xFE},
+    {0xD7DC, 0x07},
+    {0xD7DD, 0xFF},
+    {0xD7DE, 0x07},
+    {0xD7DF, 0x7E},
+    {0xD7E0, 0xC3},
+    {0xD7E1, 0xFE},
+    {0xD7E2, 0x07},
+    {0xD7E3, 0x0E},
+    {0xD7E5, 0xFE},
+    {0xD7E6, 0x07},
+    {0xD7E7, 0xFF},
+    {0xD7E8, 0xC7},
+    {0xD7E9, 0xFE},
+    {0xD7EA, 0x03},
+    {0xD7EB, 0xE3},
+    {0xD7ED, 0x7F},
+    {0xD7EE, 0xFF},
+    {0xD7EF, 0xFF},
+    {0xD7F0, 0x02},
+    {0xD7F1, 0xFF},
+    {0xD7F2, 0xFB},
+    {0xD7F3, 0x1C},
+    {0xD7F5, 0xFE},
+    {0xD7F6, 0xFE},
+    {0xD7FF, 0x30},
+    {0xD803, 0x3F},
+    {0xD805, 0x1E},
+    {0xD807, 0x1E},
+    {0xD809, 0x7E},
+    {0xD813, 0x5F},
+    {0xD815, 0x3E},
+    {0xD817, 0x02},
+    {0xD819, 0x06},
+    {0xD81B, 0xFC},
+    {0xD825, 0x3C},
+    {0xD826, 0xE0},
+    {0xD827, 0x0C},
+    {0xD828, 0x03},
+    {0xD829, 0x1C},
+    {0xD82A, 0x03},
+    {0xD82B, 0x3C},
+    {0xD82C, 0x07},
+    {0xD82D, 0xC0},
+    {0xD82E, 0x81},
+    {0xD82F, 0xE1},
+    {0xD830, 0x71},
+    {0xD831, 0x1C},
+    {0xD832, 0x01},
+    {0xD833, 0x1C},
+    {0xD834, 0x0F},
+    {0xD835, 0x06},
+    {0xD836, 0x01},
+    {0xD837, 0x30},
+    {0xD838, 0xA1},
+    {0xD847, 0x02},
+    {0xD849, 0x06},
+    {0xD84B, 0x06},
+    {0xD857, 0x01},
+    {0xD85F, 0x02},
+    {0xD863, 0x42},
+    {0xD864, 0x42},
+    {0xD865, 0x42},
+    {0xD866, 0xC2},
+    {0xD867, 0x02},
+    {0xD869, 0x86},
+    {0xD87D, 0xFE},
+    {0xD87E, 0x01},
+    {0xD87F, 0x03},
+    {0xD880, 0x03},
+    {0xD881, 0x03},
+    {0xD882, 0x04},
+};
+
+#endif // EVENT_MASKS_H
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "mgba_wrapper.h"
+#include "event_masks.h" // regenerate with scripts/gen_event_masks.py
 
 typedef struct {
     uint16_t address;
@@ -0,0 +1,86 @@
+// macro_actions.h - Multi-frame key sequences addressed by discrete actions
+// With macro actions enabled the action space is the GB_ACTION_COUNT single
+// buttons followed by MACRO_COUNT sequences. A sequence plays out entirely in
+// one c_step through STEP_N_FRAMES_VARIED, so menus, text and tile walks
+// cost one policy call instead of several.
+#ifndef MACRO_ACTIONS_H
+#define MACRO_ACTIONS_H
+
+#include "mgba_wrapper.h"
+#include <pthread.h>
+#include <stdint.h>
+
+#define MACRO_MAX_FRAMES 64
+
+typedef enum {
+  MACRO_TAP_A = 0, // press A, then release so the next press registers
+  MACRO_TAP_B,
+  MACRO_WALK_RIGHT, // hold a direction for one full tile step
+  MACRO_WALK_LEFT,
+  MACRO_WALK_UP,
+  MACRO_WALK_DOWN,
+  MACRO_MASH_A, // alternate A / released to advance text
+  MACRO_MASH_B, // same with B, which also backs out of menus
+  MACRO_COUNT
+} MacroActionId;
+
+#define MACRO_ACTION_SPACE (GB_ACTION_COUNT + MACRO_COUNT)
+
+// Compact description: `repeat` times, hold `keys` for `hold` frames then
+// release for `release` frames
+typedef struct {
+  const char *name;
+  uint8_t keys;
+  uint8_t hold;
+  uint8_t release;
+  uint8_t repeat;
+} MacroSpec;
+
+static const MacroSpec MACRO_SPECS[MACRO_COUNT] = {
+    {"tap_a", GB_KEY_A, 4, 4, 1},
+    {"tap_b", GB_KEY_B, 4, 4, 1},
+    // A tile step is 16 frames once the turn-in-place check has passed
+    {"walk_right", GB_KEY_RIGHT, 16, 0, 1},
+    {"walk_left", GB_KEY_LEFT, 16, 0, 1},
+    {"walk_up", GB_KEY_UP, 16, 0, 1},
+    {"walk_down", GB_KEY_DOWN, 16, 0, 1},
+    {"mash_a", GB_KEY_A, 2, 6, 6},
+    {"mash_b", GB_KEY_B, 2, 6, 6},
+};
+
+typedef struct {
+  uint8_t length;
+  uint8_t keys[MACRO_MAX_FRAMES];
+} MacroSequence;
+
+// Expanded per-frame keys, built once per process
+static MacroSequence g_macro_table[MACRO_COUNT];
+static pthread_once_t g_macro_table_once = PTHREAD_ONCE_INIT;
+
+static void macro_build_table(void) {
+  for (int m = 0; m < MACRO_COUNT; m++) {
+    const MacroSpec *spec = &MACRO_SPECS[m];
+    MacroSequence *seq = &g_macro_table[m];
+    int n = 0;
+    for (int r = 0; r < spec->repeat; r++) {
+      for (int i = 0; i < spec->hold && n < MACRO_MAX_FRAMES; i++)
+        seq->keys[n++] = spec->keys;
+      for (int i = 0; i < spec->release && n < MACRO_MAX_FRAMES; i++)
+        seq->keys[n++] = 0;
+    }
+    seq->length = (uint8_t)n;
+  }
+}
+
+static inline void macro_table_init(void) {
+  pthread_once(&g_macro_table_once, macro_build_table);
+}
+
+// Sequence for an action index, or NULL for single-button actions
+static inline const MacroSequence *macro_for_action(int action) {
+  if (action < GB_ACTION_COUNT || action >= MACRO_ACTION_SPACE)
+    return NULL;
+  return &g_macro_table[action - GB_ACTION_COUNT];
+}
+
+#endif // MACRO_ACTIONS_H
@@ -2,6 +2,8 @@
 #define MGBA_WRAPPER_H
 
 #include <SDL2/SDL.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -23,6 +25,55 @@
 #include <mgba/gb/core.h>
 #include <mgba/gb/interface.h>
 
+#include "savestate.h"
+#include "shm.h"
+
+// savestate_save blob (core state + SRAM) decoded once per state file and
+// shared read-only by every env in the process. With a state cache name set
+// (mgba_share_state_cache) the blob lives in a named shm segment, so sibling
+// worker processes decode the file once between them.
+typedef struct StateCacheEntry {
+  char path[256];
+  void *data;
+  size_t size;
+  ShmSegment segment; // mapping behind data when shared, unused otherwise
+  int users;
+  struct StateCacheEntry *next;
+} StateCacheEntry;
+
+// Start of a shared state segment; the blob starts on the next page so it
+// can be made read-only on its own
+typedef struct {
+  ShmHeader shm;
+  uint32_t loaded; // 0 when the creator could not load the state file
+  uint64_t state_size;
+  char path[256];
+} StateCacheHeader;
+
+#define STATE_CACHE_MAGIC 0x53534331u // "SSC1"
+#define STATE_CACHE_VERSION 1
+#define STATE_CACHE_DATA_OFFSET 4096
+
+// DMG shades (lightest first) pinned for BG, OBJ0 and OBJ1 so every pixel in
+// the video buffer is one of exactly four known colours. These match mGBA's
+// built-in grey palette, so pinning them changes no output.
+static const uint32_t DMG_PALETTE[4] = {0xFFFFFF, 0xAAAAAA, 0x555555, 0x000000};
+
+// DMG work RAM (0xC000-0xDFFF); every address the env reads lives here
+#define WRAM_BASE 0xC000
+#define WRAM_SIZE 0x2000
+
+// Video memory read by the tilemap observation
+#define VRAM_BASE 0x8000
+#define VRAM_SIZE 0x2000
+#define OAM_BASE 0xFE00
+#define OAM_SIZE 0xA0
+#define GB_REG_LCDC 0xFF40
+#define GB_REG_SCY 0xFF42
+#define GB_REG_SCX 0xFF43
+#define GB_REG_WY 0xFF4A
+#define GB_REG_WX 0xFF4B
+
 typedef struct {
   struct mCore *core;
   color_t *video_buffer;
@@ -31,6 +82,7 @@ typedef struct {
   int32_t frame_skip;
   bool render_enabled;
   bool uses_shared_rom;
+  StateCacheEntry *cached_state;
   SDL_Window *window;
   SDL_Renderer *renderer;
   SDL_Texture *texture;
@@ -39,6 +91,14 @@ typedef struct {
   int video_height;
   bool renderer_initialized;
   bool sdl_registered;
+  int video_layers;     // BG/window/OBJ count from listVideoLayers
+  bool video_layers_on; // last state passed to enableVideoLayer
+  // Core-owned WRAM/VRAM/OAM buffers. GBMemoryReset and GBVideoReset free and
+  // reallocate them, so every core->reset must go through mgba_reset_core.
+  const uint8_t *wram_block; // core's live WRAM, NULL -> rawRead8 fallback
+  uint8_t wram[WRAM_SIZE];   // per-step snapshot read by read_wram()
+  const uint8_t *vram_block; // live VRAM bank 0 and OAM, NULL -> rawRead8
+  const uint8_t *oam_block;
 } mGBA;
 
 #include "optim.h" // needed below mGBA struct?
@@ -70,9 +130,15 @@ typedef enum {
 
 
 void mgba_init_core(mGBA *env, const char *rom_path);
-void initial_load_state(mGBA *env, const char *state_path);
+bool mgba_map_wram(mGBA *env);
+void mgba_reset_core(mGBA *env);
+bool initial_load_state(mGBA *env, const char *state_path);
 bool c_save_state_file(mGBA *env, const char *path);
 bool c_load_state_file(mGBA *env, const char *path);
+void mgba_share_state_cache(const char *name);
+bool mgba_cache_state(mGBA *env, const char *state_path);
+bool mgba_restore_cached_state(mGBA *env);
+void mgba_release_cached_state(mGBA *env);
 
 static void silent_log(struct mLogger *logger, int category, enum mLogLevel level, const char *format, va_list args) {
   (void)logger;
@@ -82,9 +148,16 @@ static void silent_log(struct mLogger *logger, int category, enum mLogLevel leve
   (void)args;
 }
 static struct mLogger s_silentLogger = {.log = silent_log, .filter = NULL};
+static pthread_once_t s_logger_once = PTHREAD_ONCE_INIT;
+static void install_silent_logger(void) {
+  mLogSetDefaultLogger(&s_silentLogger);
+}
 static int g_stderr_backup = -1;
 static int g_devnull_fd = -1;
+// stderr is process-wide, so concurrent loaders (parallel init) take turns
+static pthread_mutex_t g_stderr_lock = PTHREAD_MUTEX_INITIALIZER;
 static inline void suppress_stderr(void) {
+  pthread_mutex_lock(&g_stderr_lock);
   fflush(stderr);
   g_stderr_backup = dup(STDERR_FILENO);
   g_devnull_fd = open("/dev/null", O_WRONLY);
@@ -103,6 +176,7 @@ static inline void restore_stderr(void) {
     close(g_devnull_fd);
     g_devnull_fd = -1;
   }
+  pthread_mutex_unlock(&g_stderr_lock);
 }
 
 static inline uint32_t action_to_key(int action) {
@@ -114,22 +188,66 @@ static inline void set_keys(mGBA *env, uint32_t action) {
   if (env && env->core)
     env->core->setKeys(env->core, action & 0xFF);
 }
+// Turns PPU pixel output for every layer on or off. Off frames still run the
+// full emulation; only the renderer's per-line drawing is skipped.
+static inline void mgba_set_video_layers(mGBA *env, bool on) {
+  if (env->video_layers_on == on)
+    return;
+  for (int i = 0; i < env->video_layers; i++)
+    env->core->enableVideoLayer(env->core, (size_t)i, on);
+  env->video_layers_on = on;
+}
 static inline uint8_t read_mem(mGBA *env, uint16_t addr) {
   return env && env->core ? (uint8_t)env->core->rawRead8(env->core, addr, -1)
                           : 0;
 }
-static inline uint32_t read_bcd(mGBA *env, uint16_t addr) {
-  uint8_t h = read_mem(env, addr);
-  uint8_t m = read_mem(env, addr + 1);
-  uint8_t l = read_mem(env, addr + 2);
+// Snapshot the whole of WRAM with one copy so the per-step reward, battle and
+// event reads below are plain array lookups instead of rawRead8 calls
+static inline void mgba_snapshot_wram(mGBA *env) {
+  if (!env || !env->core)
+    return;
+  if (env->wram_block) {
+    memcpy(env->wram, env->wram_block, WRAM_SIZE);
+    return;
+  }
+  for (uint32_t i = 0; i < WRAM_SIZE; i++)
+    env->wram[i] = (uint8_t)env->core->rawRead8(env->core, WRAM_BASE + i, -1);
+}
+// addr must be in 0xC000-0xDFFF; valid after the step's mgba_snapshot_wram()
+static inline uint8_t read_wram(const mGBA *env, uint16_t addr) {
+  return env->wram[(uint16_t)(addr - WRAM_BASE) & (WRAM_SIZE - 1)];
+}
+// Live WRAM byte for per-frame checks where a full snapshot would cost more
+static inline uint8_t read_wram_live(mGBA *env, uint16_t addr) {
+  if (env->wram_block)
+    return env->wram_block[(uint16_t)(addr - WRAM_BASE) & (WRAM_SIZE - 1)];
+  return read_mem(env, addr);
+}
+static inline uint32_t bcd_decode(uint8_t h, uint8_t m, uint8_t l) {
   return ((h >> 4) * 100000) + ((h & 0xF) * 10000) + ((m >> 4) * 1000) +
          ((m & 0xF) * 100) + ((l >> 4) * 10) + (l & 0xF);
 }
+// Live reads, any address
+static inline uint32_t read_bcd(mGBA *env, uint16_t addr) {
+  return bcd_decode(read_mem(env, addr), read_mem(env, addr + 1),
+                    read_mem(env, addr + 2));
+}
 static inline uint16_t read_uint16(mGBA *env, uint16_t addr) {
   uint8_t low = read_mem(env, addr);
   uint8_t high = read_mem(env, addr + 1);
   return (uint16_t)(low | (high << 8));
 }
+// Same reads from the step's WRAM snapshot, for update_ram; addr + size must
+// stay inside 0xC000-0xDFFF
+static inline uint32_t read_bcd_wram(const mGBA *env, uint16_t addr) {
+  return bcd_decode(read_wram(env, addr), read_wram(env, addr + 1),
+                    read_wram(env, addr + 2));
+}
+static inline uint16_t read_uint16_wram(const mGBA *env, uint16_t addr) {
+  uint8_t low = read_wram(env, addr);
+  uint8_t high = read_wram(env, addr + 1);
+  return (uint16_t)(low | (high << 8));
+}
 
 static inline void write_mem(mGBA *env, uint16_t addr, uint8_t value) {
   if (env && env->core)
@@ -373,11 +491,44 @@ static void mgba_render_frame(mGBA *env) {
   SDL_RenderPresent(env->renderer);
 }
 
+// Find the core's WRAM block so snapshots are a memcpy, plus VRAM and OAM for
+// the tilemap observation. The buffers are owned by the core: loadState
+// copies into them, but a core reset allocates new ones, so the pointers are
+// looked up again after each reset (mgba_reset_core).
+static const uint8_t *mgba_find_block(mGBA *env, uint32_t start,
+                                      size_t min_size) {
+  const struct mCoreMemoryBlock *blocks = NULL;
+  size_t count = env->core->listMemoryBlocks(env->core, &blocks);
+  for (size_t i = 0; i < count; i++) {
+    if (blocks[i].start != start)
+      continue;
+    size_t size = 0;
+    const uint8_t *mem =
+        (const uint8_t *)env->core->getMemoryBlock(env->core, blocks[i].id, &size);
+    return mem && size >= min_size ? mem : NULL;
+  }
+  return NULL;
+}
+bool mgba_map_wram(mGBA *env) {
+  env->wram_block = mgba_find_block(env, WRAM_BASE, WRAM_SIZE);
+  env->vram_block = mgba_find_block(env, VRAM_BASE, VRAM_SIZE);
+  env->oam_block = mgba_find_block(env, OAM_BASE, OAM_SIZE);
+  return env->wram_block != NULL;
+}
+// The only place the core is reset; re-maps the buffers the reset replaced
+void mgba_reset_core(mGBA *env) {
+  env->core->reset(env->core);
+  mgba_map_wram(env);
+}
 void mgba_init_core(mGBA *env, const char *rom_path) {
   if (!env)
     return;
 
   env->uses_shared_rom = false;
+  env->cached_state = NULL;
+  env->wram_block = NULL;
+  env->vram_block = NULL;
+  env->oam_block = NULL;
   env->window = NULL;
   env->renderer = NULL;
   env->texture = NULL;
@@ -385,21 +536,55 @@ void mgba_init_core(mGBA *env, const char *rom_path) {
   env->renderer_initialized = false;
   env->sdl_registered = false;
 
-  mLogSetDefaultLogger(&s_silentLogger);
-  env->core = mCoreFind(rom_path);
+  pthread_once(&s_logger_once, install_silent_logger);
+  // One shared read-only ROM mapping for every core; private load fallback
+  const void *rom = get_shared_rom(rom_path);
+  size_t rom_size = rom ? get_shared_rom_size() : 0;
+  if (rom) {
+    env->uses_shared_rom = true;
+    struct VFile *probe = VFileFromConstMemory(rom, rom_size);
+    env->core = probe ? mCoreFindVF(probe) : NULL;
+    if (probe)
+      probe->close(probe);
+  } else {
+    env->core = mCoreFind(rom_path);
+  }
   if (!env->core || !env->core->init(env->core)) {
     fprintf(stderr, "Failed to initialize mGBA core\n");
     env->core = NULL;
+    if (env->uses_shared_rom) {
+      release_shared_rom();
+      env->uses_shared_rom = false;
+    }
     return;
   }
   mCoreInitConfig(env->core, NULL);
   mCoreConfigSetValue(&env->core->config, "sgb.borders", "0");
   mCoreConfigSetValue(&env->core->config, "gb.model", "DMG");
+  for (unsigned int i = 0; i < 12; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "gb.pal[%u]", i);
+    mCoreConfigSetUIntValue(&env->core->config, key, DMG_PALETTE[i & 3]);
+  }
   env->core->loadConfig(env->core, &env->core->config);
-  if (!mCoreLoadFile(env->core, rom_path)) {
+  bool loaded;
+  if (env->uses_shared_rom) {
+    // The core keeps (and eventually closes) the VFile, not the mapping
+    struct VFile *vf = VFileFromConstMemory(rom, rom_size);
+    loaded = vf && env->core->loadROM(env->core, vf);
+    if (!loaded && vf)
+      vf->close(vf);
+  } else {
+    loaded = mCoreLoadFile(env->core, rom_path);
+  }
+  if (!loaded) {
     fprintf(stderr, "Failed to load ROM: %s\n", rom_path);
     env->core->deinit(env->core);
     env->core = NULL;
+    if (env->uses_shared_rom) {
+      release_shared_rom();
+      env->uses_shared_rom = false;
+    }
     return;
   }
   unsigned int w, h;
@@ -412,9 +597,13 @@ void mgba_init_core(mGBA *env, const char *rom_path) {
   env->video_height = (int)h;
   
   configure_headless_mode(env->core);
-  
-  env->core->reset(env->core);
-  strncpy(env->rom_path, rom_path, sizeof(env->rom_path) - 1);
+  const struct mCoreChannelInfo *layers = NULL;
+  env->video_layers = (int)env->core->listVideoLayers(env->core, &layers);
+  env->video_layers_on = true;
+
+  if (env->rom_path != rom_path)
+    strncpy(env->rom_path, rom_path, sizeof(env->rom_path) - 1);
+  mgba_reset_core(env);
 }
 bool c_save_state_file(mGBA *env, const char *path) {
   if (!env || !env->core || !path)
@@ -438,19 +627,171 @@ bool c_load_state_file(mGBA *env, const char *path) {
   vf->close(vf);
   return result;
 }
-void initial_load_state(mGBA *env, const char *state_path) {
+bool initial_load_state(mGBA *env, const char *state_path) {
   struct VFile *vf = VFileOpen(state_path, O_RDONLY);
-  if (vf) {
-    suppress_stderr();
-    bool load_success = mCoreLoadStateNamed(env->core, vf, SAVESTATE_ALL);
-    restore_stderr();
-    vf->close(vf);
-    if (!load_success) {
-      fprintf(stderr, "Warning: Failed to load state from file: %s\n", state_path);
-    }
-  } else {
+  if (!vf) {
     fprintf(stderr, "Warning: Could not open state file: %s\n", state_path);
+    return false;
+  }
+  suppress_stderr();
+  bool load_success = mCoreLoadStateNamed(env->core, vf, SAVESTATE_ALL);
+  restore_stderr();
+  vf->close(vf);
+  if (!load_success)
+    fprintf(stderr, "Warning: Failed to load state from file: %s\n", state_path);
+  return load_success;
+}
+
+
+static StateCacheEntry *g_state_cache = NULL;
+static pthread_mutex_t g_state_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+// Segment name prefix; empty keeps the cache private to the process
+static char g_state_cache_name[40];
+
+// Worker processes given the same name (the run id) share their decoded
+// states. Set before any env caches a state.
+void mgba_share_state_cache(const char *name) {
+  pthread_mutex_lock(&g_state_cache_lock);
+  snprintf(g_state_cache_name, sizeof(g_state_cache_name), "%s",
+           name ? name : "");
+  pthread_mutex_unlock(&g_state_cache_lock);
+}
+
+// Decodes the file into a private anonymous mapping
+static bool state_cache_decode(mGBA *env, const char *state_path,
+                               StateCacheEntry *entry) {
+  if (!initial_load_state(env, state_path))
+    return false;
+  size_t size = savestate_size(env->core);
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED)
+    return false;
+  if (!savestate_save(env->core, data)) {
+    fprintf(stderr, "Warning: Failed to serialize state: %s\n", state_path);
+    munmap(data, size);
+    return false;
+  }
+  mprotect(data, size, PROT_READ);
+  entry->data = data;
+  entry->size = size;
+  return true;
+}
+
+typedef struct {
+  mGBA *env;
+  const char *path;
+  size_t size;
+} StateCacheInit;
+
+// Runs in the creating process only; siblings wait for it to publish
+static void state_cache_init(void *base, const void *arg) {
+  const StateCacheInit *init = (const StateCacheInit *)arg;
+  StateCacheHeader *header = (StateCacheHeader *)base;
+  header->state_size = init->size;
+  snprintf(header->path, sizeof(header->path), "%s", init->path);
+  // The SRAM block can be swapped by the load; the blob size must not change
+  header->loaded =
+      initial_load_state(init->env, init->path) &&
+      savestate_size(init->env->core) == init->size &&
+      savestate_save(init->env->core, (uint8_t *)base + STATE_CACHE_DATA_OFFSET);
+}
+static bool state_cache_match(const void *base, const void *arg) {
+  const StateCacheInit *init = (const StateCacheInit *)arg;
+  const StateCacheHeader *header = (const StateCacheHeader *)base;
+  return header->state_size == init->size &&
+         strncmp(header->path, init->path, sizeof(header->path)) == 0;
+}
+
+// The first worker to open the segment for a path decodes the file into it;
+// the others map its blob. Named by the run id and a hash of the path.
+static bool state_cache_attach(mGBA *env, const char *state_path,
+                               StateCacheEntry *entry) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  for (const char *c = state_path; *c; c++) {
+    hash ^= (uint8_t)*c;
+    hash *= 0x100000001B3ull;
+  }
+  char name[sizeof(entry->segment.name)];
+  snprintf(name, sizeof(name), "%s_%016llx", g_state_cache_name,
+           (unsigned long long)hash);
+  StateCacheInit init = {env, state_path, savestate_size(env->core)};
+  if (!shm_segment_open(&entry->segment, name,
+                        STATE_CACHE_DATA_OFFSET + init.size, STATE_CACHE_MAGIC,
+                        STATE_CACHE_VERSION, state_cache_init,
+                        state_cache_match, &init))
+    return false;
+  StateCacheHeader *header = (StateCacheHeader *)entry->segment.base;
+  if (!header->loaded) {
+    fprintf(stderr, "Warning: No state decoded into /%s for %s\n", name,
+            state_path);
+    shm_segment_close(&entry->segment);
+    return false;
+  }
+  entry->data = (uint8_t *)entry->segment.base + STATE_CACHE_DATA_OFFSET;
+  entry->size = init.size;
+  mprotect(entry->data, entry->size, PROT_READ);
+  return true;
+}
+
+// The first env to ask for a path pays for the file open + PNG decode (or
+// maps a sibling worker's blob), later envs just savestate_load it. Nothing
+// is cached when the file does not load, so a bad path fails env init
+// instead of becoming a power-on state that every reset reuses.
+bool mgba_cache_state(mGBA *env, const char *state_path) {
+  if (!env || !env->core || !state_path || !state_path[0])
+    return false;
+  mgba_release_cached_state(env);
+
+  pthread_mutex_lock(&g_state_cache_lock);
+  StateCacheEntry *entry = g_state_cache;
+  while (entry && strcmp(entry->path, state_path) != 0)
+    entry = entry->next;
+
+  if (!entry) {
+    entry = (StateCacheEntry *)calloc(1, sizeof(StateCacheEntry));
+    bool cached =
+        entry && (g_state_cache_name[0]
+                      ? state_cache_attach(env, state_path, entry)
+                      : state_cache_decode(env, state_path, entry));
+    if (!cached) {
+      free(entry);
+      pthread_mutex_unlock(&g_state_cache_lock);
+      return false;
+    }
+    strncpy(entry->path, state_path, sizeof(entry->path) - 1);
+    entry->next = g_state_cache;
+    g_state_cache = entry;
+  }
+  entry->users++;
+  env->cached_state = entry;
+  pthread_mutex_unlock(&g_state_cache_lock);
+  return true;
+}
+bool mgba_restore_cached_state(mGBA *env) {
+  if (!env || !env->core || !env->cached_state)
+    return false;
+  return savestate_load(env->core, env->cached_state->data);
+}
+void mgba_release_cached_state(mGBA *env) {
+  if (!env || !env->cached_state)
+    return;
+  pthread_mutex_lock(&g_state_cache_lock);
+  StateCacheEntry *entry = env->cached_state;
+  env->cached_state = NULL;
+  if (--entry->users == 0) {
+    StateCacheEntry **curr = &g_state_cache;
+    while (*curr && *curr != entry)
+      curr = &(*curr)->next;
+    if (*curr)
+      *curr = entry->next;
+    if (entry->segment.users > 0)
+      shm_segment_close(&entry->segment);
+    else
+      munmap(entry->data, entry->size);
+    free(entry);
   }
+  pthread_mutex_unlock(&g_state_cache_lock);
 }
 
-#endif // MGBA_WRAPPER_H
\ No newline at end of file
+#endif // MGBA_WRAPPER_H
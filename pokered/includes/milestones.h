@@ -0,0 +1,70 @@
+// milestones.h - Per-env lock-free milestone ring
+// The stepping thread pushes a record when something notable happens (badge,
+// catch, level up, event) and vec_log drains it on the Python thread, so the
+// hot path does a few stores instead of a printf syscall. Single producer,
+// single consumer; a full ring drops new records and counts them.
+#ifndef MILESTONES_H
+#define MILESTONES_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MILESTONE_RING_SIZE 256 // power of two
+
+typedef enum {
+  MILESTONE_BADGE = 0, // value = badge byte
+  MILESTONE_CATCH,     // value = party count
+  MILESTONE_LEVEL,     // value = level sum
+  MILESTONE_EVENT,     // value = EVENT_LIST index
+  MILESTONE_KIND_COUNT
+} MilestoneKind;
+
+static const char *const MILESTONE_NAMES[MILESTONE_KIND_COUNT] = {
+    "badge", "catch", "level", "event"};
+
+typedef struct {
+  uint32_t env_id;
+  uint32_t step;
+  uint16_t kind; // MilestoneKind
+  uint16_t value;
+} Milestone;
+
+typedef struct {
+  _Atomic uint32_t head; // written by the producer only
+  _Atomic uint32_t tail; // written by the consumer only
+  _Atomic uint32_t dropped;
+  Milestone slots[MILESTONE_RING_SIZE];
+} MilestoneRing;
+
+static inline void milestone_ring_init(MilestoneRing *ring) {
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->dropped, 0);
+}
+static inline bool milestone_push(MilestoneRing *ring, Milestone record) {
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail == MILESTONE_RING_SIZE) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return false;
+  }
+  ring->slots[head & (MILESTONE_RING_SIZE - 1)] = record;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  return true;
+}
+static inline bool milestone_pop(MilestoneRing *ring, Milestone *out) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (tail == head)
+    return false;
+  *out = ring->slots[tail & (MILESTONE_RING_SIZE - 1)];
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return true;
+}
+// Consumer side: returns and resets the drop count
+static inline uint32_t milestone_take_dropped(MilestoneRing *ring) {
+  return atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+}
+
+#endif // MILESTONES_H
@@ -0,0 +1,237 @@
+// obs.h - Observation kernels (framebuffer -> policy input)
+#ifndef OBS_H
+#define OBS_H
+
+#include "mgba_wrapper.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define GB_SCREEN_WIDTH 160
+#define GB_SCREEN_HEIGHT 144
+#define OBS_SCALED_WIDTH (GB_SCREEN_WIDTH / 2)
+#define OBS_SCALED_HEIGHT (GB_SCREEN_HEIGHT / 2)
+#define OBS_PACKED_BYTES (GB_SCREEN_WIDTH * GB_SCREEN_HEIGHT / 4)
+
+// Visible 20x18 tile window, then the 40 raw OAM entries (y, x, tile, flags)
+#define OBS_TILEMAP_COLS (GB_SCREEN_WIDTH / 8)
+#define OBS_TILEMAP_ROWS (GB_SCREEN_HEIGHT / 8)
+#define OBS_TILEMAP_TILES (OBS_TILEMAP_COLS * OBS_TILEMAP_ROWS)
+#define OBS_OAM_ENTRIES 40
+#define OBS_TILEMAP_BYTES (OBS_TILEMAP_TILES + OAM_SIZE)
+
+typedef enum {
+  OBS_MODE_FLOAT = 0, // 80x72 float greyscale (original layout)
+  OBS_MODE_UINT8 = 1, // 80x72 uint8 greyscale
+  OBS_MODE_PACKED = 2, // 160x144 2-bit shade indices, 4 pixels per byte
+  OBS_MODE_TILEMAP = 3, // 20x18 BG/window tile indices + OAM, no pixels
+  OBS_MODE_COUNT
+} ObsMode;
+
+// Integer BT.601 luma, weights sum to 256 so grey pixels map to themselves.
+// Every SIMD path below produces exactly the same bytes as this reference.
+static inline uint32_t obs_luma(color_t pixel) {
+  uint32_t r = (pixel >> 16) & 0xFF;
+  uint32_t g = (pixel >> 8) & 0xFF;
+  uint32_t b = pixel & 0xFF;
+  return (77 * r + 150 * g + 29 * b) >> 8;
+}
+
+// One output row of 2x2-pooled luma from two source rows
+static inline void obs_pool_row_scalar(const color_t *row0, const color_t *row1,
+                                       uint8_t *dst, int x0) {
+  for (int x = x0; x < GB_SCREEN_WIDTH; x += 2) {
+    uint32_t sum = obs_luma(row0[x]) + obs_luma(row0[x + 1]) +
+                   obs_luma(row1[x]) + obs_luma(row1[x + 1]);
+    dst[x >> 1] = (uint8_t)((sum + 2) >> 2);
+  }
+}
+
+#if defined(__AVX2__)
+static inline __m256i obs_luma_avx2(__m256i px) {
+  const __m256i mask = _mm256_set1_epi32(0xFF);
+  __m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 16), mask);
+  __m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 8), mask);
+  __m256i b = _mm256_and_si256(px, mask);
+  __m256i y = _mm256_mullo_epi32(r, _mm256_set1_epi32(77));
+  y = _mm256_add_epi32(y, _mm256_mullo_epi32(g, _mm256_set1_epi32(150)));
+  y = _mm256_add_epi32(y, _mm256_mullo_epi32(b, _mm256_set1_epi32(29)));
+  return _mm256_srli_epi32(y, 8);
+}
+// 16 source pixels x 2 rows -> 8 output bytes per iteration
+static inline void obs_pool_row(const color_t *row0, const color_t *row1,
+                                uint8_t *dst) {
+  int x = 0;
+  for (; x + 16 <= GB_SCREEN_WIDTH; x += 16) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)(row0 + x));
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(row0 + x + 8));
+    __m256i b0 = _mm256_loadu_si256((const __m256i *)(row1 + x));
+    __m256i b1 = _mm256_loadu_si256((const __m256i *)(row1 + x + 8));
+    __m256i s0 = _mm256_add_epi32(obs_luma_avx2(a0), obs_luma_avx2(b0));
+    __m256i s1 = _mm256_add_epi32(obs_luma_avx2(a1), obs_luma_avx2(b1));
+    // hadd works per 128-bit lane; the permute restores pixel order
+    __m256i h = _mm256_hadd_epi32(s0, s1);
+    h = _mm256_permute4x64_epi64(h, _MM_SHUFFLE(3, 1, 2, 0));
+    h = _mm256_srli_epi32(_mm256_add_epi32(h, _mm256_set1_epi32(2)), 2);
+    __m256i p = _mm256_packus_epi32(h, h);
+    p = _mm256_packus_epi16(p, p);
+    int32_t lo = _mm256_cvtsi256_si32(p);
+    int32_t hi = _mm256_extract_epi32(p, 4);
+    memcpy(dst + (x >> 1), &lo, 4);
+    memcpy(dst + (x >> 1) + 4, &hi, 4);
+  }
+  obs_pool_row_scalar(row0, row1, dst, x);
+}
+#elif defined(__SSE4_1__)
+static inline __m128i obs_luma_sse(__m128i px) {
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  __m128i r = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+  __m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+  __m128i b = _mm_and_si128(px, mask);
+  __m128i y = _mm_mullo_epi32(r, _mm_set1_epi32(77));
+  y = _mm_add_epi32(y, _mm_mullo_epi32(g, _mm_set1_epi32(150)));
+  y = _mm_add_epi32(y, _mm_mullo_epi32(b, _mm_set1_epi32(29)));
+  return _mm_srli_epi32(y, 8);
+}
+// 8 source pixels x 2 rows -> 4 output bytes per iteration
+static inline void obs_pool_row(const color_t *row0, const color_t *row1,
+                                uint8_t *dst) {
+  int x = 0;
+  for (; x + 8 <= GB_SCREEN_WIDTH; x += 8) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x));
+    __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + x + 4));
+    __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x));
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + x + 4));
+    __m128i s0 = _mm_add_epi32(obs_luma_sse(a0), obs_luma_sse(b0));
+    __m128i s1 = _mm_add_epi32(obs_luma_sse(a1), obs_luma_sse(b1));
+    __m128i h = _mm_hadd_epi32(s0, s1);
+    h = _mm_srli_epi32(_mm_add_epi32(h, _mm_set1_epi32(2)), 2);
+    __m128i p = _mm_packus_epi32(h, h);
+    p = _mm_packus_epi16(p, p);
+    int32_t out = _mm_cvtsi128_si32(p);
+    memcpy(dst + (x >> 1), &out, 4);
+  }
+  obs_pool_row_scalar(row0, row1, dst, x);
+}
+#elif defined(__ARM_NEON)
+static inline uint8x16_t obs_luma_neon(uint8x16x4_t px) {
+  // vld4 deinterleaves little-endian color_t into b, g, r, x planes
+  uint16x8_t lo = vmull_u8(vget_low_u8(px.val[2]), vdup_n_u8(77));
+  lo = vmlal_u8(lo, vget_low_u8(px.val[1]), vdup_n_u8(150));
+  lo = vmlal_u8(lo, vget_low_u8(px.val[0]), vdup_n_u8(29));
+  uint16x8_t hi = vmull_u8(vget_high_u8(px.val[2]), vdup_n_u8(77));
+  hi = vmlal_u8(hi, vget_high_u8(px.val[1]), vdup_n_u8(150));
+  hi = vmlal_u8(hi, vget_high_u8(px.val[0]), vdup_n_u8(29));
+  return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+// 16 source pixels x 2 rows -> 8 output bytes per iteration
+static inline void obs_pool_row(const color_t *row0, const color_t *row1,
+                                uint8_t *dst) {
+  int x = 0;
+  for (; x + 16 <= GB_SCREEN_WIDTH; x += 16) {
+    uint8x16_t l0 = obs_luma_neon(vld4q_u8((const uint8_t *)(row0 + x)));
+    uint8x16_t l1 = obs_luma_neon(vld4q_u8((const uint8_t *)(row1 + x)));
+    uint16x8_t sum = vpadalq_u8(vpaddlq_u8(l0), l1);
+    vst1_u8(dst + (x >> 1), vrshrn_n_u16(sum, 2));
+  }
+  obs_pool_row_scalar(row0, row1, dst, x);
+}
+#else
+static inline void obs_pool_row(const color_t *row0, const color_t *row1,
+                                uint8_t *dst) {
+  obs_pool_row_scalar(row0, row1, dst, 0);
+}
+#endif
+
+// 160x144 framebuffer -> 80x72 greyscale bytes
+static inline void obs_downsample_u8(const color_t *RESTRICT vbuf,
+                                     uint8_t *RESTRICT dst) {
+  for (int sy = 0; sy < OBS_SCALED_HEIGHT; sy++) {
+    const color_t *row0 = vbuf + (sy * 2) * GB_SCREEN_WIDTH;
+    obs_pool_row(row0, row0 + GB_SCREEN_WIDTH, dst + sy * OBS_SCALED_WIDTH);
+  }
+}
+
+// Green channel -> DMG shade index (0 = lightest palette entry). The palette
+// is greyscale, so one channel is enough; nearest match absorbs the RGB555
+// round trip mGBA applies to the configured colours.
+static inline void obs_build_shade_lut(uint8_t lut[256],
+                                       const uint32_t palette[4]) {
+  for (int g = 0; g < 256; g++) {
+    int best = 0, best_dist = 256;
+    for (int i = 0; i < 4; i++) {
+      int dist = abs(g - (int)((palette[i] >> 8) & 0xFF));
+      if (dist < best_dist) {
+        best = i;
+        best_dist = dist;
+      }
+    }
+    lut[g] = (uint8_t)best;
+  }
+}
+
+// 160x144 framebuffer -> 5760 bytes; pixel x of a row lands in byte x / 4 at
+// bits 2 * (x % 4) (LSB first), rows are 40 bytes apart
+static inline void obs_pack_2bpp(const color_t *RESTRICT vbuf,
+                                 const uint8_t *RESTRICT lut,
+                                 uint8_t *RESTRICT dst) {
+  for (int i = 0; i < GB_SCREEN_WIDTH * GB_SCREEN_HEIGHT; i += 4) {
+    dst[i >> 2] = (uint8_t)(lut[(vbuf[i] >> 8) & 0xFF] |
+                            lut[(vbuf[i + 1] >> 8) & 0xFF] << 2 |
+                            lut[(vbuf[i + 2] >> 8) & 0xFF] << 4 |
+                            lut[(vbuf[i + 3] >> 8) & 0xFF] << 6);
+  }
+}
+
+static inline uint8_t obs_vram(mGBA *env, uint16_t addr) {
+  if (env->vram_block)
+    return env->vram_block[(addr - VRAM_BASE) & (VRAM_SIZE - 1)];
+  return (uint8_t)env->core->rawRead8(env->core, addr, 0);
+}
+
+// Tile indices on screen at 8x8 granularity: the BG map scrolled by SCX/SCY
+// with wraparound, overlaid by the window where it is enabled (text boxes and
+// menus). Indices are raw map bytes; LCDC bit 4 only changes which tile data
+// they address, and Pokemon Red never flips it mid-game.
+static inline void obs_copy_tilemap(mGBA *env, uint8_t *RESTRICT dst) {
+  struct mCore *core = env->core;
+  uint8_t lcdc = (uint8_t)core->rawRead8(core, GB_REG_LCDC, -1);
+  uint8_t scy = (uint8_t)core->rawRead8(core, GB_REG_SCY, -1);
+  uint8_t scx = (uint8_t)core->rawRead8(core, GB_REG_SCX, -1);
+  int wy = (uint8_t)core->rawRead8(core, GB_REG_WY, -1);
+  int wx = (int)(uint8_t)core->rawRead8(core, GB_REG_WX, -1) - 7;
+  uint16_t bg_map = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+  uint16_t win_map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+  bool window = (lcdc & 0x20) && wy < GB_SCREEN_HEIGHT && wx < GB_SCREEN_WIDTH;
+
+  for (int r = 0; r < OBS_TILEMAP_ROWS; r++) {
+    int y = r * 8;
+    uint16_t bg_row = bg_map + ((((scy + y) >> 3) & 31) << 5);
+    bool win_row = window && y >= wy;
+    uint16_t win_base = win_map + (((y - wy) >> 3) << 5);
+    uint8_t *out = dst + r * OBS_TILEMAP_COLS;
+    for (int c = 0; c < OBS_TILEMAP_COLS; c++) {
+      int x = c * 8;
+      uint16_t addr = win_row && x >= wx
+                          ? win_base + ((x - wx) >> 3)
+                          : bg_row + (((scx + x) >> 3) & 31);
+      out[c] = obs_vram(env, addr);
+    }
+  }
+
+  uint8_t *oam = dst + OBS_TILEMAP_TILES;
+  if (env->oam_block) {
+    memcpy(oam, env->oam_block, OAM_SIZE);
+  } else {
+    for (int i = 0; i < OAM_SIZE; i++)
+      oam[i] = (uint8_t)core->rawRead8(core, OAM_BASE + i, -1);
+  }
+}
+
+#endif // OBS_H
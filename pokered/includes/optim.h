@@ -5,6 +5,12 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Branch prediction hints
 #ifndef LIKELY
@@ -72,10 +78,66 @@
     }                                               \
 } while(0)
 
-// Shared ROM stubs (disabled - mmap issues with Python multiprocessing)
-static inline void release_shared_rom(void) {}
-static inline void* get_shared_rom(void) { return NULL; }
-static inline size_t get_shared_rom_size(void) { return 0; }
+// Shared read-only ROM image. The file is mapped MAP_SHARED/PROT_READ once per
+// process and every core reads it through VFileFromConstMemory, so cores in
+// this process share one mapping and all worker processes share the same
+// page-cache pages (forked children inherit the mapping as-is). mGBA copies
+// the ROM before any write (patches/cheats), so read-only pages are safe.
+typedef struct {
+    char path[256];
+    const void* data;
+    size_t size;
+    int users;
+} SharedRom;
+
+static SharedRom g_shared_rom = {{0}, NULL, 0, 0};
+static pthread_mutex_t g_shared_rom_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns the mapped ROM (one reference per call), or NULL if it cannot be
+// mapped or a different ROM is already shared; callers then load privately
+static inline const void* get_shared_rom(const char* path) {
+    if (UNLIKELY(!path)) return NULL;
+    const void* data = NULL;
+    pthread_mutex_lock(&g_shared_rom_lock);
+    if (g_shared_rom.data) {
+        if (strncmp(g_shared_rom.path, path, sizeof(g_shared_rom.path)) == 0) {
+            g_shared_rom.users++;
+            data = g_shared_rom.data;
+        }
+        pthread_mutex_unlock(&g_shared_rom_lock);
+        return data;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            strncpy(g_shared_rom.path, path, sizeof(g_shared_rom.path) - 1);
+            g_shared_rom.data = map;
+            g_shared_rom.size = (size_t)st.st_size;
+            g_shared_rom.users = 1;
+            data = map;
+        }
+    }
+    if (fd >= 0) close(fd);
+    pthread_mutex_unlock(&g_shared_rom_lock);
+    return data;
+}
+static inline size_t get_shared_rom_size(void) {
+    pthread_mutex_lock(&g_shared_rom_lock);
+    size_t size = g_shared_rom.size;
+    pthread_mutex_unlock(&g_shared_rom_lock);
+    return size;
+}
+// Drop one reference; only call after the core using it has been deinit'd
+static inline void release_shared_rom(void) {
+    pthread_mutex_lock(&g_shared_rom_lock);
+    if (g_shared_rom.users > 0 && --g_shared_rom.users == 0) {
+        munmap((void*)g_shared_rom.data, g_shared_rom.size);
+        memset(&g_shared_rom, 0, sizeof(g_shared_rom));
+    }
+    pthread_mutex_unlock(&g_shared_rom_lock);
+}
 
 // Configure core for headless RL mode (disables audio)
 static inline void configure_headless_mode(struct mCore* core) {
@@ -117,36 +179,80 @@ static inline void aligned_free(void* ptr) {
 #endif
 }
 
-// Performance counters (debug only, enable with -DENABLE_PERF_COUNTERS)
+// Per-env step profiler (PROFILE=1 builds, or -DENABLE_PERF_COUNTERS).
+// Each env accumulates nanoseconds per pipeline phase plus a step latency
+// histogram; vec_log drains them into perf/* keys. Disabled builds compile
+// every macro away and the env carries no counters.
 #ifdef ENABLE_PERF_COUNTERS
   #include <time.h>
-  
+
+  typedef enum {
+      PERF_EMULATE,
+      PERF_RAM,
+      PERF_REWARD,
+      PERF_OBS,
+      PERF_RESET,
+      PERF_LOG,
+      PERF_PHASE_COUNT
+  } PerfPhase;
+
+  static const char* const PERF_PHASE_NAMES[PERF_PHASE_COUNT] = {
+      "emulate", "ram", "reward", "obs", "reset", "log"};
+
+  // 4 buckets per power of two, so percentiles are within 25%; the top
+  // bucket catches anything past ~7.5 s
+  #define PERF_HIST_BUCKETS 128
+
   typedef struct {
-      uint64_t step_count;
-      double total_step_time;
-      double total_obs_time;
-      double last_fps;
+      uint64_t phase_ns[PERF_PHASE_COUNT];
+      uint64_t step_ns;
+      uint64_t steps;
+      uint64_t frames;
+      uint32_t hist[PERF_HIST_BUCKETS];
   } PerfCounters;
-  
-  static THREAD_LOCAL PerfCounters g_perf = {0};
-  
-  #define PERF_START(name) \
-      struct timespec _perf_start_##name; \
-      clock_gettime(CLOCK_MONOTONIC, &_perf_start_##name)
-  
-  #define PERF_END(name, counter) do { \
-      struct timespec _perf_end; \
-      clock_gettime(CLOCK_MONOTONIC, &_perf_end); \
-      double _elapsed = (_perf_end.tv_sec - _perf_start_##name.tv_sec) + \
-                       (_perf_end.tv_nsec - _perf_start_##name.tv_nsec) / 1e9; \
-      g_perf.counter += _elapsed; \
-  } while(0)
-  
-  #define PERF_INC_STEP() (g_perf.step_count++)
+
+  static inline uint64_t perf_now_ns(void) {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+  }
+  static inline int perf_bucket(uint64_t ns) {
+      if (ns < 4) return (int)ns;
+      int lg = 63 - __builtin_clzll(ns);
+      int bucket = (lg - 1) * 4 + (int)((ns >> (lg - 2)) & 3);
+      return bucket < PERF_HIST_BUCKETS ? bucket : PERF_HIST_BUCKETS - 1;
+  }
+  // Upper edge of a bucket in ns
+  static inline double perf_bucket_ns(int bucket) {
+      if (bucket < 4) return (double)bucket + 1.0;
+      int lg = bucket / 4 + 1;
+      return (double)((uint64_t)(4 + bucket % 4 + 1) << (lg - 2));
+  }
+  static inline double perf_percentile_ns(const uint32_t* hist, uint64_t total, double q) {
+      uint64_t target = (uint64_t)(q * (double)total);
+      uint64_t seen = 0;
+      for (int b = 0; b < PERF_HIST_BUCKETS; b++) {
+          seen += hist[b];
+          if (seen > target) return perf_bucket_ns(b);
+      }
+      return perf_bucket_ns(PERF_HIST_BUCKETS - 1);
+  }
+  static inline void perf_record_step(PerfCounters* perf, uint64_t ns, int frames) {
+      perf->step_ns += ns;
+      perf->steps++;
+      perf->frames += (uint64_t)frames;
+      perf->hist[perf_bucket(ns)]++;
+  }
+
+  #define PERF_START(name) uint64_t _perf_##name = perf_now_ns()
+  #define PERF_END(perf, name, phase) \
+      ((perf)->phase_ns[(phase)] += perf_now_ns() - _perf_##name)
+  #define PERF_STEP(perf, name, frames) \
+      perf_record_step((perf), perf_now_ns() - _perf_##name, (frames))
 #else
-  #define PERF_START(name)        ((void)0)
-  #define PERF_END(name, counter) ((void)0)
-  #define PERF_INC_STEP()         ((void)0)
+  #define PERF_START(name)               ((void)0)
+  #define PERF_END(perf, name, phase)    ((void)0)
+  #define PERF_STEP(perf, name, frames)  ((void)0)
 #endif
 
 #endif // OPTIM_H
\ No newline at end of file
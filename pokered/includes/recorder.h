@@ -0,0 +1,353 @@
+// recorder.h - Compact deterministic trajectory recording
+// One append-only file per env: a header with the config that decides how
+// an action turns into frames, then a stream of chunks. A segment chunk
+// starts every stretch of play from a known state (each reset, and each
+// vec_restore): it carries the FNV-1a hash of that state, and a keyframe
+// with the state itself unless it came straight from state_path. Actions are
+// one byte per step, buffered and flushed as RLE chunks; every
+// keyframe_interval steps a keyframe (the RLE'd savestate_save blob) is added so
+// a replay can seek without running the segment from its start.
+//
+// The file is mmap'd and grown in doubling ftruncate steps. header->length
+// only covers whole chunks and is bumped after each one is written, so a
+// crashed run leaves a readable prefix (minus the unflushed actions).
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <fcntl.h>
+#include <mgba/core/core.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "savestate.h"
+
+#define RECORD_MAGIC 0x50525252u // "PRRR"
+#define RECORD_VERSION 2 // 2: keyframes and hashes include SRAM
+#define RECORD_CHUNK_STEPS 1024 // actions buffered per RLE chunk
+#define RECORD_INITIAL_BYTES (1u << 20)
+#define RECORD_ALIGN 8
+
+typedef enum {
+  RECORD_SEGMENT = 1, // payload RecordSegment, step = first step
+  RECORD_ACTIONS = 2, // one byte per step from `step` on
+  RECORD_KEYFRAME = 3, // core savestate after `step` steps of the segment
+} RecordChunkType;
+
+// RecordChunk.flags
+#define RECORD_RLE 0x1 // payload is record_rle_encode output
+
+// RecordSegment.origin
+typedef enum {
+  RECORD_FROM_STATE_FILE = 0, // state_path, fast_options, then settle frames
+  RECORD_FROM_KEYFRAME = 1,   // the next chunk is its keyframe
+} RecordOrigin;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t length; // bytes of whole chunks, header included
+  uint32_t state_size;
+  uint32_t keyframe_interval;
+  int32_t frame_skip;
+  int32_t max_frameskip;
+  uint8_t adaptive_frameskip;
+  uint8_t macro_actions;
+  uint8_t fast_options;
+  uint8_t instant_text;
+  int32_t env_id;
+  char state_path[256];
+} RecordHeader;
+
+typedef struct {
+  uint16_t type;  // RecordChunkType
+  uint16_t flags; // RECORD_RLE
+  uint32_t bytes; // payload as stored
+  uint32_t raw_bytes;
+  uint32_t step;
+  uint64_t hash; // FNV-1a of the raw payload; segments: of the start state
+} RecordChunk;
+
+typedef struct {
+  uint32_t origin;        // RecordOrigin
+  uint32_t settle_keys;   // held while c_reset runs its settle frames
+  uint32_t settle_frames; // run after the state load, before step 0
+  uint32_t reserved;
+} RecordSegment;
+
+_Static_assert(sizeof(RecordChunk) % RECORD_ALIGN == 0,
+               "chunk payloads start aligned");
+_Static_assert(sizeof(RecordHeader) % RECORD_ALIGN == 0,
+               "first chunk starts aligned");
+
+typedef struct {
+  int fd;
+  uint8_t *map;
+  size_t capacity; // mapped bytes, >= header->length
+  uint8_t *state_buf; // state_size scratch for keyframes and hashes
+  uint32_t keyframe_interval; // 0 = keyframes only where a segment needs one
+  uint32_t pending_step;      // segment step of actions[0]
+  uint32_t num_pending;
+  uint8_t actions[RECORD_CHUNK_STEPS];
+} Recorder;
+
+static inline uint64_t record_hash(const uint8_t *data, size_t n) {
+  uint64_t h = 0xCBF29CE484222325ull;
+  for (size_t i = 0; i < n; i++) {
+    h ^= data[i];
+    h *= 0x100000001B3ull;
+  }
+  return h;
+}
+
+// Control byte c < 128: c + 1 literal bytes follow. c >= 128: the next
+// byte repeats c - 125 times (3..130). Savestates are mostly zero runs and
+// held buttons give long action runs, so this is enough.
+static inline size_t record_rle_bound(size_t n) { return n + n / 128 + 1; }
+
+static inline size_t record_rle_encode(const uint8_t *src, size_t n,
+                                       uint8_t *dst) {
+  size_t out = 0, i = 0, lit = 0; // lit: start of the pending literal run
+  while (i < n) {
+    size_t run = 1;
+    while (i + run < n && run < 130 && src[i + run] == src[i])
+      run++;
+    if (run < 3 && i - lit < 128) {
+      i++;
+      continue;
+    }
+    while (lit < i) {
+      size_t len = i - lit < 128 ? i - lit : 128;
+      dst[out++] = (uint8_t)(len - 1);
+      memcpy(dst + out, src + lit, len);
+      out += len;
+      lit += len;
+    }
+    if (run >= 3) {
+      dst[out++] = (uint8_t)(run + 125);
+      dst[out++] = src[i];
+      i += run;
+      lit = i;
+    }
+  }
+  while (lit < n) {
+    size_t len = n - lit < 128 ? n - lit : 128;
+    dst[out++] = (uint8_t)(len - 1);
+    memcpy(dst + out, src + lit, len);
+    out += len;
+    lit += len;
+  }
+  return out;
+}
+
+// false if the stream is malformed or does not decode to exactly n bytes
+static inline bool record_rle_decode(const uint8_t *src, size_t bytes,
+                                     uint8_t *dst, size_t n) {
+  size_t in = 0, out = 0;
+  while (in < bytes) {
+    uint8_t c = src[in++];
+    if (c < 128) {
+      size_t len = (size_t)c + 1;
+      if (in + len > bytes || out + len > n)
+        return false;
+      memcpy(dst + out, src + in, len);
+      in += len;
+      out += len;
+    } else {
+      size_t len = (size_t)c - 125;
+      if (in >= bytes || out + len > n)
+        return false;
+      memset(dst + out, src[in++], len);
+      out += len;
+    }
+  }
+  return out == n;
+}
+
+static inline RecordHeader *record_header(const Recorder *rec) {
+  return (RecordHeader *)rec->map;
+}
+
+// Makes room for `bytes` past header->length, remapping if the file grows
+static bool record_reserve(Recorder *rec, size_t bytes) {
+  size_t need = record_header(rec)->length + bytes;
+  if (need <= rec->capacity)
+    return true;
+  size_t capacity = rec->capacity;
+  while (capacity < need)
+    capacity *= 2;
+  if (ftruncate(rec->fd, (off_t)capacity) != 0)
+    return false;
+  void *map =
+      mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, rec->fd, 0);
+  if (map == MAP_FAILED)
+    return false;
+  munmap(rec->map, rec->capacity);
+  rec->map = (uint8_t *)map;
+  rec->capacity = capacity;
+  return true;
+}
+
+// Appends one chunk, RLE-compressing the payload if that makes it smaller
+static bool record_append(Recorder *rec, RecordChunkType type, uint32_t step,
+                          uint64_t hash, const void *payload, size_t n,
+                          bool compress) {
+  if (!record_reserve(rec, sizeof(RecordChunk) + record_rle_bound(n) +
+                               RECORD_ALIGN))
+    return false;
+  RecordHeader *header = record_header(rec);
+  RecordChunk *chunk = (RecordChunk *)(rec->map + header->length);
+  uint8_t *dst = (uint8_t *)(chunk + 1);
+  size_t stored = compress ? record_rle_encode(payload, n, dst) : n;
+  chunk->flags = 0;
+  if (compress && stored < n) {
+    chunk->flags = RECORD_RLE;
+  } else {
+    memcpy(dst, payload, n);
+    stored = n;
+  }
+  chunk->type = (uint16_t)type;
+  chunk->bytes = (uint32_t)stored;
+  chunk->raw_bytes = (uint32_t)n;
+  chunk->step = step;
+  chunk->hash = hash;
+  size_t end = sizeof(RecordChunk) + stored;
+  end = (end + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1);
+  memset(dst + stored, 0, end - sizeof(RecordChunk) - stored);
+  header->length += end;
+  return true;
+}
+
+static bool record_flush(Recorder *rec) {
+  if (rec->num_pending == 0)
+    return true;
+  bool ok = record_append(rec, RECORD_ACTIONS, rec->pending_step,
+                          record_hash(rec->actions, rec->num_pending),
+                          rec->actions, rec->num_pending, true);
+  rec->pending_step += rec->num_pending;
+  rec->num_pending = 0;
+  return ok;
+}
+
+// Creates (truncating) `path`. The header fields other than magic, version,
+// length and state_size come from the caller.
+static bool record_open(Recorder *rec, const char *path,
+                        const RecordHeader *config, uint32_t keyframe_interval) {
+  memset(rec, 0, sizeof(*rec));
+  rec->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (rec->fd < 0)
+    return false;
+  rec->capacity = RECORD_INITIAL_BYTES;
+  rec->state_buf = (uint8_t *)malloc(config->state_size);
+  void *map = MAP_FAILED;
+  if (rec->state_buf && ftruncate(rec->fd, (off_t)rec->capacity) == 0)
+    map = mmap(NULL, rec->capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+               rec->fd, 0);
+  if (map == MAP_FAILED) {
+    free(rec->state_buf);
+    close(rec->fd);
+    unlink(path);
+    memset(rec, 0, sizeof(*rec));
+    return false;
+  }
+  rec->map = (uint8_t *)map;
+  rec->keyframe_interval = keyframe_interval;
+  RecordHeader *header = record_header(rec);
+  *header = *config;
+  header->magic = RECORD_MAGIC;
+  header->version = RECORD_VERSION;
+  header->keyframe_interval = keyframe_interval;
+  header->length = sizeof(RecordHeader);
+  return true;
+}
+
+// Saves, hashes and (optionally) appends the core's current state, returning
+// its hash; 0 if the core could not serialize
+static uint64_t record_state(Recorder *rec, struct mCore *core, uint32_t step,
+                             bool keyframe) {
+  uint32_t size = record_header(rec)->state_size;
+  if (savestate_size(core) != size || !savestate_save(core, rec->state_buf))
+    return 0;
+  uint64_t hash = record_hash(rec->state_buf, size);
+  if (keyframe)
+    record_append(rec, RECORD_KEYFRAME, step, hash, rec->state_buf, size, true);
+  return hash;
+}
+
+// Starts a segment at the core's current state
+static void record_segment(Recorder *rec, struct mCore *core, uint32_t step,
+                           RecordOrigin origin, uint32_t settle_keys,
+                           uint32_t settle_frames) {
+  record_flush(rec);
+  rec->pending_step = step;
+  RecordSegment segment = {(uint32_t)origin, settle_keys, settle_frames, 0};
+  uint64_t hash = record_state(rec, core, step, false);
+  record_append(rec, RECORD_SEGMENT, step, hash, &segment, sizeof(segment),
+                false);
+  if (origin == RECORD_FROM_KEYFRAME)
+    record_append(rec, RECORD_KEYFRAME, step, hash, rec->state_buf,
+                  record_header(rec)->state_size, true);
+}
+
+// Logs one action once its frames have run; `steps` counts it
+static inline void record_step(Recorder *rec, struct mCore *core,
+                               uint32_t steps, uint8_t action) {
+  rec->actions[rec->num_pending++] = action;
+  if (rec->num_pending == RECORD_CHUNK_STEPS)
+    record_flush(rec);
+  if (rec->keyframe_interval && steps % rec->keyframe_interval == 0) {
+    record_flush(rec);
+    record_state(rec, core, steps, true);
+  }
+}
+
+// Flushes, trims the file to its chunks and releases everything
+static void record_close(Recorder *rec) {
+  if (!rec->map)
+    return;
+  record_flush(rec);
+  size_t length = record_header(rec)->length;
+  munmap(rec->map, rec->capacity);
+  if (ftruncate(rec->fd, (off_t)length) != 0)
+    fprintf(stderr, "Warning: could not trim recording to %zu bytes\n", length);
+  close(rec->fd);
+  free(rec->state_buf);
+  memset(rec, 0, sizeof(*rec));
+}
+
+// Reading side, used by pokered_replay. Returns the chunk at *offset and
+// advances it, or NULL at the end of the valid chunks.
+static inline const RecordChunk *record_next(const uint8_t *map,
+                                             uint64_t length,
+                                             uint64_t *offset) {
+  if (*offset + sizeof(RecordChunk) > length)
+    return NULL;
+  const RecordChunk *chunk = (const RecordChunk *)(map + *offset);
+  uint64_t end = *offset + sizeof(RecordChunk) + chunk->bytes;
+  if (end > length)
+    return NULL;
+  *offset = (end + RECORD_ALIGN - 1) & ~(uint64_t)(RECORD_ALIGN - 1);
+  return chunk;
+}
+
+// Decodes a chunk payload into dst (chunk->raw_bytes) and checks its hash
+static inline bool record_payload(const RecordChunk *chunk, uint8_t *dst) {
+  const uint8_t *src = (const uint8_t *)(chunk + 1);
+  if (chunk->flags & RECORD_RLE) {
+    if (!record_rle_decode(src, chunk->bytes, dst, chunk->raw_bytes))
+      return false;
+  } else {
+    if (chunk->bytes != chunk->raw_bytes)
+      return false;
+    memcpy(dst, src, chunk->bytes);
+  }
+  return chunk->type == RECORD_SEGMENT ||
+         record_hash(dst, chunk->raw_bytes) == chunk->hash;
+}
+
+#endif // RECORDER_H
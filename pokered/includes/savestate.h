@@ -0,0 +1,66 @@
+// savestate.h - In-memory savestates that include cartridge SRAM
+// mCore::saveState covers the CPU, memory and video state but not the
+// battery-backed cartridge RAM; the .ss1 loader (mCoreLoadStateNamed with
+// SAVESTATE_ALL) restores that from the savedata extdata instead. In Pokemon
+// Red the SRAM holds the in-game save and the PC boxes, so a bare saveState
+// blob would let them carry over from one restore to the next and let cloned
+// envs drift apart. Every in-memory state (the reset cache, snapshots, the
+// frontier archive and recorder keyframes) is therefore the saveState blob
+// followed by the SRAM bytes.
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <mgba/core/core.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SAVESTATE_SRAM_BASE 0xA000
+
+// The core's live SRAM. Looked up on every call: loading a .ss1 can swap the
+// buffer (savedata masking), so the pointer is not cached.
+static inline uint8_t *savestate_sram(struct mCore *core, size_t *size) {
+  const struct mCoreMemoryBlock *blocks = NULL;
+  size_t count = core->listMemoryBlocks(core, &blocks);
+  for (size_t i = 0; i < count; i++) {
+    if (blocks[i].start != SAVESTATE_SRAM_BASE)
+      continue;
+    uint8_t *mem = (uint8_t *)core->getMemoryBlock(core, blocks[i].id, size);
+    if (mem)
+      return mem;
+  }
+  *size = 0;
+  return NULL;
+}
+
+static inline size_t savestate_size(struct mCore *core) {
+  size_t sram_size;
+  savestate_sram(core, &sram_size);
+  return core->stateSize(core) + sram_size;
+}
+
+// buf holds savestate_size(core) bytes
+static inline bool savestate_save(struct mCore *core, void *buf) {
+  if (!core->saveState(core, buf))
+    return false;
+  size_t sram_size;
+  const uint8_t *sram = savestate_sram(core, &sram_size);
+  if (sram_size)
+    memcpy((uint8_t *)buf + core->stateSize(core), sram, sram_size);
+  return true;
+}
+
+// SRAM is copied in place rather than through savedataRestore, which with
+// writeback off masks the savedata with a new VFile on every call
+static inline bool savestate_load(struct mCore *core, const void *buf) {
+  if (!core->loadState(core, buf))
+    return false;
+  size_t sram_size;
+  uint8_t *sram = savestate_sram(core, &sram_size);
+  if (sram_size)
+    memcpy(sram, (const uint8_t *)buf + core->stateSize(core), sram_size);
+  return true;
+}
+
+#endif // SAVESTATE_H
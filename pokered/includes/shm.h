@@ -0,0 +1,139 @@
+// shm.h - Named POSIX shm segments shared by every worker process
+// The first process to open a name creates, sizes and initializes the
+// segment; the others wait until it is published and then check that it has
+// the layout they expect. Inside a process one mapping serves every env and
+// is refcounted. The creator unlinks the name when its last user closes;
+// workers that already mapped the segment keep their view. Used by the
+// frontier archive and the visit map, which each keep one ShmSegment behind
+// their own lock.
+#ifndef SHM_H
+#define SHM_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_ATTACH_WAIT_US (5 * 1000 * 1000)
+
+// First member of every segment header
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  _Atomic uint32_t ready; // set last by the creating process
+} ShmHeader;
+
+// Process-local view of the mapping, shared by all envs in the process
+typedef struct {
+  char name[64];
+  void *base;
+  size_t size;
+  bool owner; // created the segment, unlinks it on close
+  int users;
+} ShmSegment;
+
+// init lays out the creator's header past ShmHeader before it is published;
+// match checks those fields on an existing mapping
+typedef void (*ShmInitFn)(void *base, const void *arg);
+typedef bool (*ShmMatchFn)(const void *base, const void *arg);
+
+static inline void *shm_segment_map(int fd, size_t size) {
+  return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+}
+
+// Joins the process's mapping of `name`, or creates or attaches to the
+// segment. False (and the caller runs without it) if it cannot be mapped or
+// an existing one has a different layout. The caller holds the lock that
+// guards `seg`.
+static bool shm_segment_open(ShmSegment *seg, const char *name, size_t size,
+                             uint32_t magic, uint32_t version, ShmInitFn init,
+                             ShmMatchFn match, const void *arg) {
+  if (seg->users > 0) {
+    if (strcmp(seg->name, name) != 0 || seg->size != size ||
+        !match(seg->base, arg))
+      return false;
+    seg->users++;
+    return true;
+  }
+
+  memset(seg, 0, sizeof(*seg));
+  char shm_name[sizeof(seg->name) + 1];
+  snprintf(shm_name, sizeof(shm_name), "/%s", name);
+  void *map = MAP_FAILED;
+  int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  bool owner = fd >= 0;
+  if (owner) {
+    if (ftruncate(fd, (off_t)size) == 0)
+      map = shm_segment_map(fd, size);
+    if (map != MAP_FAILED) {
+      ShmHeader *header = (ShmHeader *)map;
+      header->magic = magic;
+      header->version = version;
+      init(map, arg);
+      atomic_store_explicit(&header->ready, 1, memory_order_release);
+    } else {
+      shm_unlink(shm_name);
+    }
+  } else if (errno == EEXIST && (fd = shm_open(shm_name, O_RDWR, 0)) >= 0) {
+    // Another worker created it: wait until it is sized and initialized
+    struct stat st = {0};
+    for (int waited = 0; waited < SHM_ATTACH_WAIT_US; waited += 1000) {
+      if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmHeader))
+        break;
+      usleep(1000);
+    }
+    if ((size_t)st.st_size == size)
+      map = shm_segment_map(fd, size);
+    ShmHeader *header = (ShmHeader *)map;
+    for (int waited = 0; map != MAP_FAILED && waited < SHM_ATTACH_WAIT_US;
+         waited += 1000) {
+      if (atomic_load_explicit(&header->ready, memory_order_acquire))
+        break;
+      usleep(1000);
+    }
+    if (map != MAP_FAILED &&
+        (!atomic_load(&header->ready) || header->magic != magic ||
+         header->version != version || !match(map, arg))) {
+      munmap(map, size);
+      map = MAP_FAILED;
+    }
+  }
+  if (fd >= 0)
+    close(fd);
+  if (map == MAP_FAILED)
+    return false;
+  snprintf(seg->name, sizeof(seg->name), "%s", name);
+  seg->base = map;
+  seg->size = size;
+  seg->owner = owner;
+  seg->users = 1;
+  return true;
+}
+
+// One more user of an open mapping, dropped again by shm_segment_close
+static inline void shm_segment_retain(ShmSegment *seg) {
+  if (seg->users > 0)
+    seg->users++;
+}
+
+// Returns true when this was the last user and the mapping is gone
+static bool shm_segment_close(ShmSegment *seg) {
+  if (seg->users <= 0 || --seg->users > 0)
+    return false;
+  munmap(seg->base, seg->size);
+  if (seg->owner) {
+    char shm_name[sizeof(seg->name) + 1];
+    snprintf(shm_name, sizeof(shm_name), "/%s", seg->name);
+    shm_unlink(shm_name);
+  }
+  memset(seg, 0, sizeof(*seg));
+  return true;
+}
+
+#endif // SHM_H
@@ -0,0 +1,188 @@
+// snapshot.h - Pooled in-memory savestate arena
+// Fixed-size slots (core savestate + env bookkeeping blob) are carved out of
+// chunk allocations that never move, so a slot pointer stays valid while the
+// arena grows. Released slots go on a free list and are reused before a new
+// chunk is allocated. Handles pack a per-slot generation with the slot index
+// so a handle kept past vec_release is rejected instead of aliasing a newer
+// snapshot. Generations are 31 bits (handles stay positive) and survive
+// snapshot_arena_free: regrown slots start above every generation already
+// handed out. The arena has no lock of its own: the binding only touches it
+// with the GIL held.
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "visited.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_CHUNK_SLOTS 64
+#define SNAPSHOT_ALIGN 64
+#define SNAPSHOT_GENERATION_MASK 0x7FFFFFFFu
+
+typedef struct {
+  uint8_t *data; // state_size bytes of savestate, then env_size bytes
+  VisitedSet visited;
+  VisitedSet prev_visited;
+  uint32_t generation; // bumped on release
+  bool in_use;
+} Snapshot;
+
+typedef struct {
+  Snapshot slots[SNAPSHOT_CHUNK_SLOTS];
+  uint8_t *data;
+} SnapshotChunk;
+
+typedef struct {
+  SnapshotChunk **chunks;
+  uint32_t num_chunks;
+  uint32_t *free_slots; // stack of slot indices
+  uint32_t num_free;
+  uint32_t num_live;
+  size_t state_size; // savestate_size, identical for every core on a ROM
+  size_t env_size;
+  size_t slot_bytes; // both parts, rounded up to SNAPSHOT_ALIGN
+  uint32_t generation_floor; // highest slot generation so far, kept across frees
+} SnapshotArena;
+
+// Next 31-bit generation, skipping 0 so a handle is never <= 0
+static inline uint32_t snapshot_next_generation(uint32_t generation) {
+  generation = (generation + 1) & SNAPSHOT_GENERATION_MASK;
+  return generation ? generation : 1;
+}
+
+static inline size_t snapshot_round_up(size_t n) {
+  return (n + SNAPSHOT_ALIGN - 1) & ~(size_t)(SNAPSHOT_ALIGN - 1);
+}
+
+// Sizes are fixed on first use; returns false if a caller later disagrees
+static inline bool snapshot_arena_configure(SnapshotArena *arena,
+                                            size_t state_size,
+                                            size_t env_size) {
+  if (arena->slot_bytes)
+    return arena->state_size == state_size && arena->env_size == env_size;
+  arena->state_size = state_size;
+  arena->env_size = env_size;
+  arena->slot_bytes =
+      snapshot_round_up(state_size) + snapshot_round_up(env_size);
+  return true;
+}
+
+static inline void *snapshot_state(const SnapshotArena *arena,
+                                   const Snapshot *snap) {
+  (void)arena;
+  return snap->data;
+}
+static inline void *snapshot_env(const SnapshotArena *arena,
+                                 const Snapshot *snap) {
+  return snap->data + snapshot_round_up(arena->state_size);
+}
+
+static inline bool snapshot_grow(SnapshotArena *arena) {
+  SnapshotChunk **chunks = (SnapshotChunk **)realloc(
+      arena->chunks, (arena->num_chunks + 1) * sizeof(SnapshotChunk *));
+  if (!chunks)
+    return false;
+  arena->chunks = chunks;
+  uint32_t total = (arena->num_chunks + 1) * SNAPSHOT_CHUNK_SLOTS;
+  uint32_t *free_slots =
+      (uint32_t *)realloc(arena->free_slots, total * sizeof(uint32_t));
+  if (!free_slots)
+    return false;
+  arena->free_slots = free_slots;
+
+  SnapshotChunk *chunk = (SnapshotChunk *)calloc(1, sizeof(SnapshotChunk));
+  if (!chunk)
+    return false;
+  if (posix_memalign((void **)&chunk->data, SNAPSHOT_ALIGN,
+                     SNAPSHOT_CHUNK_SLOTS * arena->slot_bytes) != 0) {
+    free(chunk);
+    return false;
+  }
+  uint32_t base = arena->num_chunks * SNAPSHOT_CHUNK_SLOTS;
+  for (int i = 0; i < SNAPSHOT_CHUNK_SLOTS; i++) {
+    Snapshot *snap = &chunk->slots[i];
+    snap->data = chunk->data + (size_t)i * arena->slot_bytes;
+    snap->generation = snapshot_next_generation(arena->generation_floor);
+    visited_init(&snap->visited, false);
+    visited_init(&snap->prev_visited, false);
+  }
+  // Push in reverse so the lowest index is handed out first
+  for (int i = SNAPSHOT_CHUNK_SLOTS - 1; i >= 0; i--)
+    arena->free_slots[arena->num_free++] = base + (uint32_t)i;
+  arena->chunks[arena->num_chunks++] = chunk;
+  return true;
+}
+
+static inline Snapshot *snapshot_slot(const SnapshotArena *arena,
+                                      uint32_t index) {
+  uint32_t chunk = index / SNAPSHOT_CHUNK_SLOTS;
+  if (chunk >= arena->num_chunks)
+    return NULL;
+  return &arena->chunks[chunk]->slots[index % SNAPSHOT_CHUNK_SLOTS];
+}
+
+static inline int64_t snapshot_handle(const Snapshot *snap, uint32_t index) {
+  return ((int64_t)snap->generation << 32) | index;
+}
+
+// Returns a free slot and its handle, or NULL when out of memory
+static inline Snapshot *snapshot_alloc(SnapshotArena *arena,
+                                       int64_t *handle) {
+  if (arena->num_free == 0 && !snapshot_grow(arena))
+    return NULL;
+  uint32_t index = arena->free_slots[--arena->num_free];
+  Snapshot *snap = snapshot_slot(arena, index);
+  snap->in_use = true;
+  arena->num_live++;
+  *handle = snapshot_handle(snap, index);
+  return snap;
+}
+
+// Live slot for a handle, NULL if it was released or never existed
+static inline Snapshot *snapshot_get(const SnapshotArena *arena,
+                                     int64_t handle) {
+  if (handle <= 0)
+    return NULL;
+  Snapshot *snap = snapshot_slot(arena, (uint32_t)(handle & 0xFFFFFFFF));
+  if (!snap || !snap->in_use ||
+      snap->generation != (uint32_t)((uint64_t)handle >> 32))
+    return NULL;
+  return snap;
+}
+
+// Visited pages stay allocated for the slot's next user
+static inline bool snapshot_release(SnapshotArena *arena, int64_t handle) {
+  Snapshot *snap = snapshot_get(arena, handle);
+  if (!snap)
+    return false;
+  snap->in_use = false;
+  snap->generation = snapshot_next_generation(snap->generation);
+  if (snap->generation > arena->generation_floor)
+    arena->generation_floor = snap->generation;
+  visited_clear(&snap->visited);
+  visited_clear(&snap->prev_visited);
+  arena->free_slots[arena->num_free++] = (uint32_t)(handle & 0xFFFFFFFF);
+  arena->num_live--;
+  return true;
+}
+
+static inline void snapshot_arena_free(SnapshotArena *arena) {
+  for (uint32_t c = 0; c < arena->num_chunks; c++) {
+    SnapshotChunk *chunk = arena->chunks[c];
+    for (int i = 0; i < SNAPSHOT_CHUNK_SLOTS; i++) {
+      visited_free(&chunk->slots[i].visited);
+      visited_free(&chunk->slots[i].prev_visited);
+    }
+    free(chunk->data);
+    free(chunk);
+  }
+  free(arena->chunks);
+  free(arena->free_slots);
+  uint32_t generation_floor = arena->generation_floor;
+  memset(arena, 0, sizeof(*arena));
+  arena->generation_floor = generation_floor;
+}
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,128 @@
+// visited.h - Sparse per-map visited-coordinate store
+// One lazily allocated bitset page per map (1 bit per x/y tile), so an env only
+// pays for the maps it has actually entered instead of a flat 16 MiB array.
+// Every bitset word that goes non-zero is recorded in a dirty list, so clearing
+// and copying cost O(tiles touched this episode), not O(pages).
+#ifndef VISITED_H
+#define VISITED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VISITED_MAX_MAPS 256
+#define VISITED_PAGE_BITS (256 * 256) // x and y are both 8-bit
+#define VISITED_PAGE_WORDS (VISITED_PAGE_BITS / 64)
+#define VISITED_PAGE_BYTES (VISITED_PAGE_WORDS * sizeof(uint64_t))
+
+typedef struct {
+  uint64_t *pages[VISITED_MAX_MAPS]; // NULL until the map is first marked
+  uint32_t num_pages;
+  uint32_t *dirty; // map << 10 | word, one entry per non-zero word
+  uint32_t num_dirty;
+  uint32_t dirty_cap;
+  bool fill; // report every tile as visited (no pages are consulted)
+} VisitedSet;
+
+// idx layout matches coord_index(): map << 16 | x << 8 | y
+static inline uint32_t visited_map(uint32_t idx) { return (idx >> 16) & 0xFF; }
+static inline uint32_t visited_bit(uint32_t idx) { return idx & 0xFFFF; }
+
+static inline bool visited_push_dirty(VisitedSet *set, uint32_t entry) {
+  if (set->num_dirty == set->dirty_cap) {
+    uint32_t cap = set->dirty_cap ? set->dirty_cap * 2 : 256;
+    uint32_t *dirty = (uint32_t *)realloc(set->dirty, cap * sizeof(uint32_t));
+    if (!dirty)
+      return false;
+    set->dirty = dirty;
+    set->dirty_cap = cap;
+  }
+  set->dirty[set->num_dirty++] = entry;
+  return true;
+}
+
+static inline void visited_init(VisitedSet *set, bool fill) {
+  memset(set, 0, sizeof(*set));
+  set->fill = fill;
+}
+static inline bool visited_test(const VisitedSet *set, uint32_t idx) {
+  if (set->fill)
+    return true;
+  const uint64_t *page = set->pages[visited_map(idx)];
+  if (!page)
+    return false;
+  uint32_t bit = visited_bit(idx);
+  return (page[bit >> 6] >> (bit & 63)) & 1;
+}
+// Returns true if the tile was not already marked
+static inline bool visited_mark(VisitedSet *set, uint32_t idx) {
+  if (set->fill)
+    return false;
+  uint32_t map = visited_map(idx);
+  uint64_t *page = set->pages[map];
+  if (!page) {
+    page = (uint64_t *)calloc(VISITED_PAGE_WORDS, sizeof(uint64_t));
+    if (!page)
+      return false;
+    set->pages[map] = page;
+    set->num_pages++;
+  }
+  uint32_t bit = visited_bit(idx);
+  uint32_t word = bit >> 6;
+  uint64_t mask = 1ULL << (bit & 63);
+  if (page[word] & mask)
+    return false;
+  if (page[word] == 0 && !visited_push_dirty(set, (map << 10) | word))
+    return false;
+  page[word] |= mask;
+  return true;
+}
+// Zeroes only the words written since the last clear; pages stay allocated so
+// the next episode reuses them
+static inline void visited_clear(VisitedSet *set) {
+  set->fill = false;
+  for (uint32_t i = 0; i < set->num_dirty; i++) {
+    uint32_t entry = set->dirty[i];
+    set->pages[entry >> 10][entry & (VISITED_PAGE_WORDS - 1)] = 0;
+  }
+  set->num_dirty = 0;
+}
+// Episode hand-off: O(1), the caller clears whichever set becomes current
+static inline void visited_swap(VisitedSet *a, VisitedSet *b) {
+  VisitedSet tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+static inline void visited_copy(VisitedSet *dst, const VisitedSet *src) {
+  visited_clear(dst);
+  dst->fill = src->fill;
+  for (uint32_t i = 0; i < src->num_dirty; i++) {
+    uint32_t entry = src->dirty[i];
+    uint32_t map = entry >> 10;
+    uint32_t word = entry & (VISITED_PAGE_WORDS - 1);
+    uint64_t *page = dst->pages[map];
+    if (!page) {
+      page = (uint64_t *)calloc(VISITED_PAGE_WORDS, sizeof(uint64_t));
+      if (!page)
+        continue;
+      dst->pages[map] = page;
+      dst->num_pages++;
+    }
+    if (!visited_push_dirty(dst, entry))
+      continue;
+    page[word] = src->pages[map][word];
+  }
+}
+static inline void visited_free(VisitedSet *set) {
+  for (int m = 0; m < VISITED_MAX_MAPS; m++) {
+    free(set->pages[m]);
+    set->pages[m] = NULL;
+  }
+  free(set->dirty);
+  set->dirty = NULL;
+  set->num_dirty = set->dirty_cap = 0;
+  set->num_pages = 0;
+}
+
+#endif // VISITED_H
@@ -0,0 +1,150 @@
+// visitmap.h - Node-wide tile visit counts shared by every worker process
+// A named POSIX shm segment holds one uint32 counter per tile, allocated in
+// 16x16-tile blocks on first visit so only touched parts of the world cost
+// memory. A directory maps (map, x / 16, y / 16) to a block; blocks are
+// handed out by a fetch-add bump allocator and published by CAS on the
+// directory entry, and counters are bumped with relaxed atomics. Nothing
+// takes a lock, and the dashboard reads the same pages through vec_visit_map.
+#ifndef VISITMAP_H
+#define VISITMAP_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "shm.h"
+
+#define VISITMAP_MAGIC 0x50525643u // "PRVC"
+#define VISITMAP_VERSION 2
+#define VISITMAP_BLOCK_DIM 16
+#define VISITMAP_BLOCK_TILES (VISITMAP_BLOCK_DIM * VISITMAP_BLOCK_DIM)
+#define VISITMAP_DIRECTORY (256 * 16 * 16) // map, x / 16, y / 16
+
+typedef struct {
+  ShmHeader shm;
+  uint32_t capacity;           // blocks
+  _Atomic uint32_t num_blocks; // bump allocator, may overshoot capacity
+  _Atomic uint32_t dropped;    // visits not counted because the pool was full
+  uint32_t pad[10];            // keep the directory on its own cache lines
+} VisitMapHeader;
+
+typedef struct {
+  ShmSegment segment;
+  VisitMapHeader *header;
+  _Atomic uint32_t *directory; // block index + 1, 0 = unassigned
+  _Atomic uint32_t *counts;    // capacity blocks of [y % 16][x % 16]
+} VisitMap;
+
+static VisitMap g_visitmap;
+static pthread_mutex_t g_visitmap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// idx layout matches coord_index(): map << 16 | x << 8 | y
+static inline uint32_t visitmap_block_key(uint32_t idx) {
+  uint32_t map = (idx >> 16) & 0xFF, x = (idx >> 8) & 0xFF, y = idx & 0xFF;
+  return map << 8 | (x >> 4) << 4 | (y >> 4);
+}
+static inline uint32_t visitmap_tile(uint32_t idx) {
+  uint32_t x = (idx >> 8) & 0xF, y = idx & 0xF;
+  return y << 4 | x;
+}
+static inline size_t visitmap_map_size(uint32_t capacity) {
+  return sizeof(VisitMapHeader) + VISITMAP_DIRECTORY * sizeof(uint32_t) +
+         (size_t)capacity * VISITMAP_BLOCK_TILES * sizeof(uint32_t);
+}
+
+static void visitmap_init_header(void *base, const void *arg) {
+  ((VisitMapHeader *)base)->capacity = *(const uint32_t *)arg;
+}
+static bool visitmap_match_header(const void *base, const void *arg) {
+  return ((const VisitMapHeader *)base)->capacity == *(const uint32_t *)arg;
+}
+
+// Creates or joins the segment `name` with room for `capacity` blocks. The
+// segment is ftruncate'd, so untouched blocks stay unbacked. Returns NULL
+// (and envs run without global counts) if it cannot be mapped or an
+// existing one has a different layout.
+static VisitMap *visitmap_open(const char *name, uint32_t capacity) {
+  pthread_mutex_lock(&g_visitmap_lock);
+  VisitMap *vm = &g_visitmap;
+  bool ok = shm_segment_open(&vm->segment, name, visitmap_map_size(capacity),
+                             VISITMAP_MAGIC, VISITMAP_VERSION,
+                             visitmap_init_header, visitmap_match_header,
+                             &capacity);
+  if (ok && vm->segment.users == 1) {
+    vm->header = (VisitMapHeader *)vm->segment.base;
+    vm->directory = (_Atomic uint32_t *)(vm->header + 1);
+    vm->counts = vm->directory + VISITMAP_DIRECTORY;
+  }
+  pthread_mutex_unlock(&g_visitmap_lock);
+  return ok ? vm : NULL;
+}
+
+// Extra reference for a view that must outlive the envs (vec_visit_map)
+static VisitMap *visitmap_retain(VisitMap *vm) {
+  pthread_mutex_lock(&g_visitmap_lock);
+  shm_segment_retain(&vm->segment);
+  pthread_mutex_unlock(&g_visitmap_lock);
+  return vm;
+}
+
+static void visitmap_close(VisitMap *vm) {
+  if (!vm)
+    return;
+  pthread_mutex_lock(&g_visitmap_lock);
+  if (shm_segment_close(&vm->segment)) {
+    vm->header = NULL;
+    vm->directory = NULL;
+    vm->counts = NULL;
+  }
+  pthread_mutex_unlock(&g_visitmap_lock);
+}
+
+// Block for a directory key, allocating one on first visit; NULL once the
+// pool is exhausted. Two envs racing on the same new block each bump the
+// allocator and the CAS loser's block is never used, which costs one block
+// of an otherwise large pool instead of a lock.
+static inline _Atomic uint32_t *visitmap_block(VisitMap *vm, uint32_t key) {
+  VisitMapHeader *header = vm->header;
+  _Atomic uint32_t *entry = &vm->directory[key];
+  uint32_t block = atomic_load_explicit(entry, memory_order_acquire);
+  if (!block) {
+    if (atomic_load_explicit(&header->num_blocks, memory_order_relaxed) >=
+        header->capacity)
+      return NULL;
+    uint32_t claimed =
+        atomic_fetch_add_explicit(&header->num_blocks, 1, memory_order_relaxed);
+    if (claimed >= header->capacity)
+      return NULL;
+    uint32_t expected = 0;
+    block = claimed + 1;
+    if (!atomic_compare_exchange_strong_explicit(entry, &expected, block,
+                                                 memory_order_acq_rel,
+                                                 memory_order_acquire))
+      block = expected;
+  }
+  return vm->counts + (size_t)(block - 1) * VISITMAP_BLOCK_TILES;
+}
+
+// Counts one visit to the tile and returns the node-wide total including it,
+// or 0 if the tile could not be counted
+static inline uint32_t visitmap_add(VisitMap *vm, uint32_t idx) {
+  _Atomic uint32_t *block = visitmap_block(vm, visitmap_block_key(idx));
+  if (!block) {
+    atomic_fetch_add_explicit(&vm->header->dropped, 1, memory_order_relaxed);
+    return 0;
+  }
+  return atomic_fetch_add_explicit(&block[visitmap_tile(idx)], 1,
+                                   memory_order_relaxed) +
+         1;
+}
+
+static inline uint32_t visitmap_blocks_used(const VisitMap *vm) {
+  uint32_t used =
+      atomic_load_explicit(&vm->header->num_blocks, memory_order_relaxed);
+  return used < vm->header->capacity ? used : vm->header->capacity;
+}
+
+#endif // VISITMAP_H
@@ -52,6 +52,9 @@ static int init_env(PokemonRedEnv *env) {
   env->max_episode_length = 20480;
   env->emu.render_enabled = true;
   env->full_reset = true;
+  env->reward_weights = REWARD_DEFAULTS;
+  env->event_scan_interval = 1;
+  select_rewards(env, REWARD_ALL);
   snprintf(env->emu.state_path, sizeof(env->emu.state_path),
            "./pokered/states/nballs.ss1");
   snprintf(env->emu.rom_path, sizeof(env->emu.rom_path),
@@ -63,19 +66,25 @@ static int init_env(PokemonRedEnv *env) {
   }
   fclose(rom_file);
 
-  mgba_init_core(&env->emu, env->emu.rom_path);
-  env->visited_coords = (uint8_t *)calloc(VISITED_COORDS_SIZE, sizeof(uint8_t));
-  env->prev_visited_coords = (uint8_t *)calloc(VISITED_COORDS_SIZE, sizeof(uint8_t));
-  memset(env->prev_visited_coords, 1, VISITED_COORDS_SIZE);
-  env->unique_coords_count = 0;
-
-  if (!env->emu.core) {
-    printf("Failed to initialize mGBA core\n");
+  if (pokered_init_env(env) != 0) {
+    printf("Failed to initialize the emulator from %s\n", env->emu.state_path);
     return -1;
   }
   return 0;
 }
 
+// The player has no vec_log, so just narrate milestones to the terminal
+static void print_milestones(PokemonRedEnv *env) {
+  Milestone m;
+  while (milestone_pop(&env->milestones, &m)) {
+    if (m.kind == MILESTONE_EVENT)
+      printf("Event completed: %s\n", EVENT_LIST[m.value].name);
+    else
+      printf("Milestone %s: %u (step %u)\n", MILESTONE_NAMES[m.kind], m.value,
+             m.step);
+  }
+}
+
 int main(int argc, char **argv) {
   PokemonRedEnv env = {0};
   init_env(&env);
@@ -92,6 +101,7 @@ int main(int argc, char **argv) {
 
     c_step(&env);
     c_render(&env);
+    print_milestones(&env);
 
     if (env.terminals[0] || env.truncations[0]) {
       printf("Episode finished (terminal=%u, truncation=%u)\n",
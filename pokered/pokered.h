@@ -1,10 +1,19 @@
 #ifndef POKEMONREDENV_H
 #define POKEMONREDENV_H
 
+#include "./includes/archive.h"
+#include "./includes/arena.h"
 #include "./includes/battle.h"
 #include "./includes/events.h"
+#include "./includes/macro_actions.h"
 #include "./includes/mgba_wrapper.h"
+#include "./includes/milestones.h"
+#include "./includes/obs.h"
 #include "./includes/party.h"
+#include "./includes/recorder.h"
+#include "./includes/snapshot.h"
+#include "./includes/visited.h"
+#include "./includes/visitmap.h"
 
 #define SCREEN_WIDTH 160
 #define SCALED_WIDTH 80
@@ -13,6 +22,21 @@
 
 #define EXTRA_OBS 5 // extras x, y, map_n, badges, party_count
 #define TOTAL_OBSERVATIONS (SCALED_PIXELS + EXTRA_OBS)
+#define TILEMAP_OBSERVATIONS (OBS_TILEMAP_BYTES + EXTRA_OBS)
+#define RESET_SETTLE_FRAMES 4 // run by c_reset after the state load
+#define ENV_ARENA_BYTES ARENA_HUGE_PAGE // struct, video buffer, one savestate
+
+// Row of the int16 stream array registered by vec_telemetry_init
+enum {
+  TELEMETRY_X = 0,
+  TELEMETRY_Y,
+  TELEMETRY_MAP,
+  TELEMETRY_BADGES,
+  TELEMETRY_EVENTS, // event_sum
+  TELEMETRY_FIELDS
+};
+_Static_assert(OBS_PACKED_BYTES == SCALED_PIXELS,
+               "packed and scaled screens share the observation layout");
 
 #define PKMN_X_ADDR 0xD362
 #define PKMN_Y_ADDR 0xD361
@@ -26,6 +50,14 @@
 #define PKM_LEVEL_ADDR_4 0xD210
 #define PKM_LEVEL_ADDR_5 0xD23C
 #define PKM_LEVEL_ADDR_6 0xD268
+// Input-ignored state used by adaptive frameskip
+#define PKMN_JOY_IGNORE_ADDR 0xCD6B   // wJoyIgnore: masked buttons
+#define PKMN_D730_ADDR 0xD730         // wd730: script / simulated input flags
+#define PKMN_D730_NO_INPUT 0xA1       // bits 0, 5, 7
+#define PKMN_D730_INSTANT_TEXT 0x40   // bit 6: PrintLetterDelay returns at once
+#define PKMN_OPTIONS_ADDR 0xD355      // wOptions
+#define PKMN_OPTIONS_FAST 0xC1        // animation off, style set, text fast
+#define PKMN_WALK_COUNTER_ADDR 0xCFC5 // wWalkCounter: frames left in a step
 // PARTY_ADDR = [0xD164, 0xD165, 0xD166, 0xD167, 0xD168, 0xD169]
 // #define PKMN1_ADDR 0xD16B
 // #define PKMN2_ADDR 0xD197
@@ -35,19 +67,71 @@
 // #define PKMN6_ADDR 0xD247
 // hm_ids = [0xC4, 0xC5, 0xC6, 0xC7, 0xC8]
 
-#define REWARD_BADGE 5.0f   // 1.0f
-#define REWARD_POKEMON 1.0f // 0.f
+// Reward components: name, bit in reward_components, default weight. Each
+// enabled set gets its own calculate_rewards specialization (REWARD_MASKS
+// below), so disabled terms are compiled out of the step instead of tested.
+#define REWARD_COMPONENTS(X)                                                   \
+  X(BADGE, badge, 0, 5.0f)     /* per badge gained */                          \
+  X(POKEMON, pokemon, 1, 1.0f) /* per party member gained */                   \
+  X(COORD, coord, 2, 0.005f)   /* new tile, twice if also new vs last episode */ \
+  X(LEVEL, level, 3, 0.5f)     /* party level sum went up */                   \
+  X(EVENT, event, 4, 0.1f)     /* per event flag set */
 // #define REWARD_MAP 0.001f    // 0.2f
-#define REWARD_UNIQUE_COORD 0.005f // 0.5f
-#define REWARD_LEVEL 0.5f
-#define REWARD_EVENT 0.1f
 // #define STAGNATION_LIMIT 1000
 
-#define MAX_MAPS 256 // def way to big for the map but oh well
-#define MAX_X 256
-#define MAX_Y 256
-#define VISITED_COORDS_SIZE (MAX_MAPS * MAX_X * MAX_Y)
+#define REWARD_BIT(NAME, name, bit, weight) REWARD_##NAME = 1u << (bit),
+#define REWARD_ONE(NAME, name, bit, weight) +1
+#define REWARD_FIELD(NAME, name, bit, weight) float name;
+#define REWARD_DEFAULT(NAME, name, bit, weight) .name = (weight),
+#define REWARD_NAME(NAME, name, bit, weight) #name,
+enum {
+  REWARD_COMPONENTS(REWARD_BIT)
+  REWARD_COMPONENT_COUNT = 0 REWARD_COMPONENTS(REWARD_ONE),
+  REWARD_ALL = (1u << REWARD_COMPONENT_COUNT) - 1,
+};
+typedef struct {
+  REWARD_COMPONENTS(REWARD_FIELD)
+} RewardWeights;
+static const RewardWeights REWARD_DEFAULTS = {REWARD_COMPONENTS(REWARD_DEFAULT)};
+static const char *const REWARD_NAMES[] = {REWARD_COMPONENTS(REWARD_NAME)};
+
+// Comma-separated component names ("all" for every one) to REWARD_* bits;
+// false on an unknown name
+static inline bool parse_reward_components(const char *list,
+                                           uint32_t *components) {
+  uint32_t mask = 0;
+  while (*list) {
+    while (*list == ' ')
+      list++;
+    size_t len = strcspn(list, ",");
+    size_t name_len = len;
+    while (name_len > 0 && list[name_len - 1] == ' ')
+      name_len--;
+    bool known = name_len == 3 && strncmp(list, "all", 3) == 0;
+    if (known)
+      mask = REWARD_ALL;
+    for (int i = 0; !known && i < REWARD_COMPONENT_COUNT; i++) {
+      if (strlen(REWARD_NAMES[i]) == name_len &&
+          strncmp(list, REWARD_NAMES[i], name_len) == 0) {
+        mask |= 1u << i;
+        known = true;
+      }
+    }
+    if (!known && name_len > 0)
+      return false;
+    list += len;
+    if (*list == ',')
+      list++;
+  }
+  *components = mask;
+  return true;
+}
+
+struct PokemonRedEnv;
+typedef float (*RewardFn)(struct PokemonRedEnv *env);
 
+// Floats only, n last: vec_log sums Logs as float arrays. 16 floats is one
+// cache line, so each env's slot in VecEnv.logs is its own line.
 typedef struct {
   float episode_length;
   float level_sum;
@@ -63,8 +147,11 @@ typedef struct {
   float pkmn5_lvl;
   float badges;
   float pkmn6_lvl;
+  float frames_per_step;
   float n;
 } Log;
+_Static_assert(sizeof(Log) == 64,
+               "Log must fill exactly one cache line of VecEnv.logs");
 
 // typedef struct {
 //   uint8_t poke_id;
@@ -87,7 +174,7 @@ typedef struct {
   uint32_t idx;  // coord_index(map_n, x, y);
 
   uint8_t badges; // read_mem(env, PKMN_BADGES_ADDR);
-  uint32_t money; // read_bcd(env, PKMN_MONEY_ADDR);
+  uint32_t money; // read_bcd_wram(env, PKMN_MONEY_ADDR);
 
   uint8_t party_count; // read_mem(env, PKMN_PARTY_COUNT_ADDR);
   uint8_t pkmn1_lvl;   // read_mem(env, PKM_LEVEL_ADDR_1);
@@ -107,28 +194,69 @@ typedef struct {
   // PartyPokemon party[6];
 } GameState;
 
-typedef struct {
-  Log log;
-  mGBA emu;
-  GameState gstate;
-  float *observations;
+// Field order is by access frequency: the first lines hold what every
+// c_step touches, configuration follows, and the large cold members (the
+// milestone ring, perf counters, the mGBA core with its paths, SDL handles
+// and WRAM snapshot) come last so they do not share lines with the counters.
+typedef struct PokemonRedEnv {
+  // Hot: per-step buffers, counters and reward baselines
+  void *observations; // float or uint8_t depending on obs_mode
   int *actions;
   float *rewards;
   unsigned char *terminals;
   unsigned char *truncations;
-
+  Log *log; // slot in VecEnv.logs (or a private one outside vec_init)
   int32_t frame_count;
   int32_t step_count;
   int32_t max_episode_length;
   float score;
-
   int32_t stagnation;
-  uint8_t *visited_coords;
-  uint8_t *prev_visited_coords;
   uint32_t unique_coords_count;
   int32_t prev_event_sum;
-  uint8_t *prev_events;
+  int32_t last_step_frames; // frames consumed by the most recent c_step
+  uint32_t archive_key;     // cell of the previous step
+  uint32_t archive_base;    // steps from state_path to this episode's start
+  GameState gstate;
+  uint8_t *prev_events; // EVENT_MASK_COUNT masked flag bytes
+  FrontierArchive *archive; // NULL unless archive_cells > 0
+  VisitMap *visit_map;       // NULL unless visit_map_blocks > 0
+  int16_t *telemetry; // TELEMETRY_FIELDS per step while streaming, else NULL
+  Recorder *recorder; // NULL unless record_dir is set
+
+  // Configuration, read every step but never written
+  RewardFn reward_fn; // specialization for reward_components
+  RewardWeights reward_weights;
+  uint32_t reward_components; // REWARD_* bits
+  int32_t event_scan_interval; // steps between event flag scans
+  int32_t obs_mode; // ObsMode
+  int32_t max_frameskip; // adaptive cap, frames per step
   bool full_reset;
+  bool clone_from_template; // start from env 0's decoded state at init
+  bool adaptive_frameskip;  // keep emulating while the game ignores input
+  bool macro_actions;       // actions >= GB_ACTION_COUNT index MACRO_SPECS
+  bool lazy_render;         // draw pixels only on the frame a step ends on
+  bool fast_options;        // write PKMN_OPTIONS_FAST after every state load
+  bool instant_text;        // hold the no-letter-delay bit during steps
+  float archive_reset_prob; // chance a reset starts from an archived cell
+  float archive_alpha;      // sampling weight (chosen + 1)^-alpha
+  float novelty_scale;      // reward scale / sqrt(node-wide tile visits)
+  int32_t env_id;
+
+  // Warm: touched on new tiles, resets and vec_log
+  VisitedSet visited_coords;
+  VisitedSet prev_visited_coords;
+  uint32_t archive_resets; // resets served by the archive, drained by vec_log
+  uint32_t rng;
+  uint8_t *archive_buf;    // savestate_size scratch for archive_read
+  uint8_t shade_lut[256];  // OBS_MODE_PACKED: green channel -> DMG shade
+
+  // Cold
+  EnvArena arena; // holds this struct when env_arenas is set
+  MilestoneRing milestones; // drained by vec_log
+#ifdef ENABLE_PERF_COUNTERS
+  PerfCounters perf; // drained by vec_log
+#endif
+  mGBA emu;
 } PokemonRedEnv;
 
 void update_ram(PokemonRedEnv *env);
@@ -139,15 +267,18 @@ void c_close(PokemonRedEnv *env);
 void allocate(PokemonRedEnv *env);
 void free_allocated(PokemonRedEnv *env);
 void add_log(PokemonRedEnv *env);
-
-static inline void update_observations(PokemonRedEnv *env) {
-  if (!env || !env->emu.video_buffer || !env->observations)
-    return;
-
+bool c_snapshot(PokemonRedEnv *env, const SnapshotArena *arena,
+                Snapshot *snap);
+bool c_restore(PokemonRedEnv *env, const SnapshotArena *arena,
+               const Snapshot *snap);
+bool c_record_open(PokemonRedEnv *env, const char *path,
+                   uint32_t keyframe_interval);
+
+static inline void update_observations_float(PokemonRedEnv *env) {
   PREFETCH_READ(env->emu.video_buffer);
   PREFETCH_WRITE(env->observations);
   const color_t *vbuf = env->emu.video_buffer;
-  float *obs = env->observations;
+  float *obs = (float *)env->observations;
   RamState *ram = &env->gstate.ram;
   // downsamepling and greyscale
   for (int sy = 0; sy < SCALED_HEIGHT; sy++) {
@@ -179,26 +310,84 @@ static inline void update_observations(PokemonRedEnv *env) {
   obs[offset + 4] = (float)ram->party_count;
 }
 
+// A quarter of the bytes per step and a SIMD kernel instead of float math
+static inline void update_observations_u8(PokemonRedEnv *env) {
+  uint8_t *obs = (uint8_t *)env->observations;
+  RamState *ram = &env->gstate.ram;
+  obs_downsample_u8(env->emu.video_buffer, obs);
+
+  // extras (all single-byte RAM values)
+  int offset = SCALED_PIXELS;
+  obs[offset + 0] = ram->x;
+  obs[offset + 1] = ram->y;
+  obs[offset + 2] = ram->map_n;
+  obs[offset + 3] = ram->badges;
+  obs[offset + 4] = ram->party_count;
+}
+
+// Full resolution at 2 bits per pixel; same byte count as the uint8 screen
+static inline void update_observations_packed(PokemonRedEnv *env) {
+  uint8_t *obs = (uint8_t *)env->observations;
+  RamState *ram = &env->gstate.ram;
+  obs_pack_2bpp(env->emu.video_buffer, env->shade_lut, obs);
+
+  int offset = OBS_PACKED_BYTES;
+  obs[offset + 0] = ram->x;
+  obs[offset + 1] = ram->y;
+  obs[offset + 2] = ram->map_n;
+  obs[offset + 3] = ram->badges;
+  obs[offset + 4] = ram->party_count;
+}
+
+// Straight from VRAM/OAM: no framebuffer read and ~11x fewer bytes than uint8
+static inline void update_observations_tilemap(PokemonRedEnv *env) {
+  uint8_t *obs = (uint8_t *)env->observations;
+  RamState *ram = &env->gstate.ram;
+  obs_copy_tilemap(&env->emu, obs);
+
+  int offset = OBS_TILEMAP_BYTES;
+  obs[offset + 0] = ram->x;
+  obs[offset + 1] = ram->y;
+  obs[offset + 2] = ram->map_n;
+  obs[offset + 3] = ram->badges;
+  obs[offset + 4] = ram->party_count;
+}
+
+static inline void update_observations(PokemonRedEnv *env) {
+  if (!env || !env->emu.video_buffer || !env->observations)
+    return;
+  switch (env->obs_mode) {
+  case OBS_MODE_UINT8:
+    update_observations_u8(env);
+    break;
+  case OBS_MODE_PACKED:
+    update_observations_packed(env);
+    break;
+  case OBS_MODE_TILEMAP:
+    update_observations_tilemap(env);
+    break;
+  default:
+    update_observations_float(env);
+    break;
+  }
+}
+
 static inline uint32_t coord_index(uint8_t map, uint8_t x, uint8_t y) {
   return ((uint32_t)map << 16) | ((uint32_t)x << 8) | (uint32_t)y;
 }
 static inline bool is_coord_visited(PokemonRedEnv *env) {
-  if (!env || !env->visited_coords)
-    return false;
-  if (env->gstate.ram.idx >= VISITED_COORDS_SIZE)
+  if (!env)
     return false;
-  return env->visited_coords[env->gstate.ram.idx];
+  return visited_test(&env->visited_coords, env->gstate.ram.idx);
 }
 static inline void mark_coord_visited(PokemonRedEnv *env) {
-  if (!env || !env->visited_coords)
-    return;
-  if (env->gstate.ram.idx >= VISITED_COORDS_SIZE)
+  if (!env)
     return;
-  env->visited_coords[env->gstate.ram.idx] = 1;
+  visited_mark(&env->visited_coords, env->gstate.ram.idx);
 }
 static inline void clear_visited_coords(PokemonRedEnv *env) {
-  if (env && env->visited_coords) {
-    memset(env->visited_coords, 0, VISITED_COORDS_SIZE);
+  if (env) {
+    visited_clear(&env->visited_coords);
   }
 }
 
@@ -208,6 +397,7 @@ void allocate(PokemonRedEnv *env) {
   env->rewards = (float *)calloc(1, sizeof(float));
   env->terminals = (unsigned char *)calloc(1, sizeof(unsigned char));
   env->truncations = (unsigned char *)calloc(1, sizeof(unsigned char));
+  env->log = (Log *)calloc(1, sizeof(Log));
 
 }
 void free_allocated(PokemonRedEnv *env) {
@@ -216,27 +406,75 @@ void free_allocated(PokemonRedEnv *env) {
   free(env->rewards);
   free(env->terminals);
   free(env->truncations);
-  free(env->visited_coords);
-  free(env->prev_visited_coords);
-  free(env->prev_events);
+  free(env->log);
+  arena_free(&env->arena, env->prev_events);
+}
+// Zeroed per-env buffer, from the env's arena while it has room
+static inline void *env_alloc(PokemonRedEnv *env, size_t size) {
+  void *ptr = arena_alloc(&env->arena, size);
+  return ptr ? ptr : calloc(1, size);
+}
+// The core allocates its frame buffer on the heap; swap in an arena copy
+static inline void place_video_buffer(PokemonRedEnv *env) {
+  mGBA *emu = &env->emu;
+  size_t bytes =
+      ((size_t)emu->video_width * emu->video_height + 256) * sizeof(color_t);
+  color_t *buffer =
+      emu->video_buffer ? (color_t *)arena_alloc(&env->arena, bytes) : NULL;
+  if (!buffer)
+    return;
+  emu->core->setVideoBuffer(emu->core, buffer, (size_t)emu->video_width);
+  free(emu->video_buffer);
+  emu->video_buffer = buffer;
+}
+// Builds the emulator side of an env whose config fields, rom_path and
+// state_path are already set: core, start-state cache, per-env buffers.
+// Training (my_init_native), the player, pokered_bench and pokered_replay
+// all construct envs through here so they cannot drift apart.
+static int pokered_init_env(PokemonRedEnv *env) {
+  milestone_ring_init(&env->milestones);
+  mgba_init_core(&env->emu, env->emu.rom_path);
+  if (!env->emu.core)
+    return -1;
+  if (env->arena.base)
+    place_video_buffer(env);
+  obs_build_shade_lut(env->shade_lut, DMG_PALETTE);
+  if (env->macro_actions)
+    macro_table_init();
+  env->rng = 0x9E3779B9u ^ ((uint32_t)env->env_id * 0x85EBCA6Bu);
+  // The first env through the cache decodes the state file; with
+  // clone_from_template that is env 0 and everyone else starts from its blob
+  if ((env->full_reset || env->clone_from_template) &&
+      !mgba_cache_state(&env->emu, env->emu.state_path))
+    return -1;
+  if (env->clone_from_template)
+    mgba_restore_cached_state(&env->emu);
+  visited_init(&env->visited_coords, false);
+  // Nothing counts as "new last episode" until a first episode has finished
+  visited_init(&env->prev_visited_coords, true);
+  env->unique_coords_count = 0;
+  env->prev_events = (uint8_t *)env_alloc(env, EVENT_MASK_COUNT);
+  return env->prev_events ? 0 : -1;
 }
 void add_log(PokemonRedEnv *env) {
   RamState *ram = &env->gstate.ram;
 
-  env->log.episode_length = env->step_count;
-  env->log.episode_return = env->score;
-  env->log.pkmn1_lvl = ram->pkmn1_lvl;
-  env->log.money = ram->money;
-  env->log.pkmn2_lvl = ram->pkmn2_lvl;
-  env->log.event_sum = env->prev_event_sum;
-  env->log.pkmn3_lvl = ram->pkmn3_lvl;
-  env->log.unique_coords = env->unique_coords_count;
-  env->log.pkmn4_lvl = ram->pkmn4_lvl;
-  env->log.party_count = ram->party_count;
-  env->log.pkmn5_lvl = ram->pkmn5_lvl;
-  env->log.badges = ram->badges;
-  env->log.pkmn6_lvl = ram->pkmn6_lvl;
-  env->log.n++;
+  env->log->episode_length = env->step_count;
+  env->log->episode_return = env->score;
+  env->log->pkmn1_lvl = ram->pkmn1_lvl;
+  env->log->money = ram->money;
+  env->log->pkmn2_lvl = ram->pkmn2_lvl;
+  env->log->event_sum = env->prev_event_sum;
+  env->log->pkmn3_lvl = ram->pkmn3_lvl;
+  env->log->unique_coords = env->unique_coords_count;
+  env->log->pkmn4_lvl = ram->pkmn4_lvl;
+  env->log->party_count = ram->party_count;
+  env->log->pkmn5_lvl = ram->pkmn5_lvl;
+  env->log->badges = ram->badges;
+  env->log->pkmn6_lvl = ram->pkmn6_lvl;
+  env->log->frames_per_step =
+      env->step_count ? (float)env->frame_count / env->step_count : 0.0f;
+  env->log->n++;
 }
 
 // void read_pkmn(mGBA *emu, Pkmn *pkmn, uint16_t start_addr) {
@@ -253,19 +491,20 @@ void add_log(PokemonRedEnv *env) {
 // }
 void update_ram(PokemonRedEnv *env) {
   RamState *ram = &env->gstate.ram;
-  ram->x = read_mem(&env->emu, PKMN_X_ADDR);
-  ram->y = read_mem(&env->emu, PKMN_Y_ADDR);
-  ram->map_n = read_mem(&env->emu, PKMN_MAP_ADDR);
+  mgba_snapshot_wram(&env->emu);
+  ram->x = read_wram(&env->emu, PKMN_X_ADDR);
+  ram->y = read_wram(&env->emu, PKMN_Y_ADDR);
+  ram->map_n = read_wram(&env->emu, PKMN_MAP_ADDR);
   ram->idx = coord_index(ram->map_n, ram->x, ram->y);
-  ram->badges = read_mem(&env->emu, PKMN_BADGES_ADDR);
-  ram->money = read_bcd(&env->emu, PKMN_MONEY_ADDR);
-  ram->party_count = read_mem(&env->emu, PKMN_PARTY_COUNT_ADDR);
-  ram->pkmn1_lvl = read_mem(&env->emu, PKM_LEVEL_ADDR_1);
-  ram->pkmn2_lvl = read_mem(&env->emu, PKM_LEVEL_ADDR_2);
-  ram->pkmn3_lvl = read_mem(&env->emu, PKM_LEVEL_ADDR_3);
-  ram->pkmn4_lvl = read_mem(&env->emu, PKM_LEVEL_ADDR_4);
-  ram->pkmn5_lvl = read_mem(&env->emu, PKM_LEVEL_ADDR_5);
-  ram->pkmn6_lvl = read_mem(&env->emu, PKM_LEVEL_ADDR_6);
+  ram->badges = read_wram(&env->emu, PKMN_BADGES_ADDR);
+  ram->money = read_bcd_wram(&env->emu, PKMN_MONEY_ADDR);
+  ram->party_count = read_wram(&env->emu, PKMN_PARTY_COUNT_ADDR);
+  ram->pkmn1_lvl = read_wram(&env->emu, PKM_LEVEL_ADDR_1);
+  ram->pkmn2_lvl = read_wram(&env->emu, PKM_LEVEL_ADDR_2);
+  ram->pkmn3_lvl = read_wram(&env->emu, PKM_LEVEL_ADDR_3);
+  ram->pkmn4_lvl = read_wram(&env->emu, PKM_LEVEL_ADDR_4);
+  ram->pkmn5_lvl = read_wram(&env->emu, PKM_LEVEL_ADDR_5);
+  ram->pkmn6_lvl = read_wram(&env->emu, PKM_LEVEL_ADDR_6);
 }
 int calc_level_sum(RamState *ram) {
   int level_sum = 0;
@@ -277,81 +516,196 @@ int calc_level_sum(RamState *ram) {
   level_sum += ram->pkmn6_lvl;
   return level_sum;
 }
-int calc_event_sum(mGBA *emu, uint8_t *prev_events) {
-  int sum = 0;
+static inline void record_milestone(PokemonRedEnv *env, MilestoneKind kind,
+                                    uint16_t value) {
+  Milestone record = {(uint32_t)env->env_id, (uint32_t)env->step_count,
+                      (uint16_t)kind, value};
+  milestone_push(&env->milestones, record);
+}
+// Cold: only runs on the steps where a flag byte gained bits
+COLD_PATH void report_new_events(PokemonRedEnv *env, uint16_t address,
+                                 uint8_t bits) {
   for (size_t i = 0; i < EVENT_COUNT; ++i) {
-    uint8_t value = read_mem(emu, EVENT_LIST[i].address);
-    uint8_t completed = (value >> EVENT_LIST[i].bit) & 1;
-    if (completed) {
-      if (prev_events && !prev_events[i]) {
-        printf("Event completed: %s\n", EVENT_LIST[i].name);
-      }
-      sum++;
-    }
+    if (EVENT_LIST[i].address == address && ((bits >> EVENT_LIST[i].bit) & 1))
+      record_milestone(env, MILESTONE_EVENT, (uint16_t)i);
+  }
+}
+// prev_events holds the masked flag byte of each EVENT_MASKS entry; when
+// track is set, bits that appeared since the last call are reported
+int calc_event_sum(PokemonRedEnv *env, bool track) {
+  uint8_t *prev_events = track ? env->prev_events : NULL;
+  int sum = 0;
+  for (size_t i = 0; i < EVENT_MASK_COUNT; ++i) {
+    uint8_t flags =
+        read_wram(&env->emu, EVENT_MASKS[i].address) & EVENT_MASKS[i].mask;
+    sum += __builtin_popcount(flags);
     if (prev_events) {
-      prev_events[i] = completed;
+      uint8_t gained = (uint8_t)(flags ^ prev_events[i]) & flags;
+      if (UNLIKELY(gained))
+        report_new_events(env, EVENT_MASKS[i].address, gained);
+      prev_events[i] = flags;
     }
   }
   return sum;
 }
-static float calculate_rewards(PokemonRedEnv *env) {
+static inline void read_event_flags(mGBA *emu, uint8_t *prev_events) {
+  if (!prev_events)
+    return;
+  for (size_t i = 0; i < EVENT_MASK_COUNT; ++i)
+    prev_events[i] = read_wram(emu, EVENT_MASKS[i].address) & EVENT_MASKS[i].mask;
+}
+// `components` is a constant in every caller, so each specialization keeps
+// only its own terms. The event scan is the expensive one: with
+// event_scan_interval K it runs every K steps and on the episode's last, and
+// event_sum (logs, archive keys, telemetry) is as fresh as the last scan.
+static FORCE_INLINE float calculate_rewards(PokemonRedEnv *env,
+                                            uint32_t components) {
   float reward = 0.0f;
-  PREFETCH_READ(env->visited_coords);
+  const RewardWeights *w = &env->reward_weights;
 
+  PERF_START(ram);
   update_ram(env);
+  PERF_END(&env->perf, ram, PERF_RAM);
+  PERF_START(reward);
   RamState *ram = &env->gstate.ram;
   RamState *prev_ram = &env->gstate.prev_ram;
 
-  int level_sum = calc_level_sum(ram);
-  int prev_level_sum = calc_level_sum(prev_ram);
-
-  if (ram->badges > prev_ram->badges) {
-    reward += REWARD_BADGE;
-    printf("You beat a gym! Badge count: %d\n", ram->badges);
+  if ((components & REWARD_BADGE) && ram->badges > prev_ram->badges) {
+    reward += w->badge;
+    record_milestone(env, MILESTONE_BADGE, ram->badges);
   }
 
-  if (ram->party_count > prev_ram->party_count && ram->party_count <= 6) {
-    reward += REWARD_POKEMON;
-    printf("You caught a new Pokemon! Party count: %d\n", ram->party_count);
+  if ((components & REWARD_POKEMON) &&
+      ram->party_count > prev_ram->party_count && ram->party_count <= 6) {
+    reward += w->pokemon;
+    record_milestone(env, MILESTONE_CATCH, ram->party_count);
   }
 
   // if (ram->map_n != prev_ram->map_n) {
   //   reward += REWARD_MAP;
   // }
 
-  if (!is_coord_visited(env)) {
+  if ((components & REWARD_COORD) && !is_coord_visited(env)) {
     mark_coord_visited(env);
     env->unique_coords_count++;
-    reward += REWARD_UNIQUE_COORD;
-    if (env->prev_visited_coords[env->gstate.ram.idx] == 0) {
-      reward += REWARD_UNIQUE_COORD; // fake memory?
+    reward += w->coord;
+    if (!visited_test(&env->prev_visited_coords, env->gstate.ram.idx)) {
+      reward += w->coord; // fake memory?
     }
   }
 
-  if (level_sum > prev_level_sum && ram->party_count == prev_ram->party_count) {
-    // int level_diff = level_sum - prev_level_sum;
-    reward += REWARD_LEVEL;
-    printf("You have leveled up! New level sum: %d\n", level_sum);
+  // Node-wide count-based novelty, counted once per tile entered
+  if (env->visit_map && ram->idx != prev_ram->idx) {
+    uint32_t visits = visitmap_add(env->visit_map, ram->idx);
+    if (visits && env->novelty_scale > 0.0f)
+      reward += env->novelty_scale / sqrtf((float)visits);
+  }
+
+  if (components & REWARD_LEVEL) {
+    int level_sum = calc_level_sum(ram);
+    int prev_level_sum = calc_level_sum(prev_ram);
+    if (level_sum > prev_level_sum &&
+        ram->party_count == prev_ram->party_count) {
+      // int level_diff = level_sum - prev_level_sum;
+      reward += w->level;
+      record_milestone(env, MILESTONE_LEVEL, (uint16_t)level_sum);
+    }
   }
 
   // Event reward delta
-  int event_sum = calc_event_sum(&env->emu, env->prev_events);
-  if (event_sum > env->prev_event_sum) {
-    reward += (event_sum - env->prev_event_sum) * REWARD_EVENT;
-    // printf("You have completed an event! New event sum: %d\n", event_sum);
+  if ((components & REWARD_EVENT) &&
+      (env->event_scan_interval <= 1 ||
+       env->step_count % env->event_scan_interval == 0 ||
+       env->step_count >= env->max_episode_length)) {
+    int event_sum = calc_event_sum(env, true);
+    if (event_sum > env->prev_event_sum) {
+      reward += (event_sum - env->prev_event_sum) * w->event;
+      // printf("You have completed an event! New event sum: %d\n", event_sum);
+    }
+    env->prev_event_sum = event_sum;
   }
 
-  env->prev_event_sum = event_sum;
   env->gstate.prev_ram = env->gstate.ram;
+  PERF_END(&env->perf, reward, PERF_REWARD);
   return reward;
 }
 
+// One calculate_rewards specialization per component set
+#define REWARD_MASKS(X)                                                        \
+  X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13)    \
+  X(14) X(15) X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25)      \
+  X(26) X(27) X(28) X(29) X(30) X(31)
+#define REWARD_VARIANT(mask)                                                   \
+  static float calculate_rewards_##mask(PokemonRedEnv *env) {                  \
+    return calculate_rewards(env, mask);                                       \
+  }
+#define REWARD_ENTRY(mask) calculate_rewards_##mask,
+REWARD_MASKS(REWARD_VARIANT)
+static const RewardFn REWARD_FNS[] = {REWARD_MASKS(REWARD_ENTRY)};
+_Static_assert(sizeof(REWARD_FNS) / sizeof(REWARD_FNS[0]) == REWARD_ALL + 1,
+               "REWARD_MASKS covers every component set");
+
+// Sets reward_components and picks its specialization; weights and the
+// event interval are left to the caller (REWARD_DEFAULTS, 1)
+static inline void select_rewards(PokemonRedEnv *env, uint32_t components) {
+  env->reward_components = components & REWARD_ALL;
+  env->reward_fn = REWARD_FNS[env->reward_components];
+}
+
+// Starts the episode from an archived frontier cell instead of state_path
+static inline bool archive_reset(PokemonRedEnv *env) {
+  if (!env->archive || archive_rand01(&env->rng) >= env->archive_reset_prob)
+    return false;
+  int cell = archive_sample(env->archive, env->archive_alpha,
+                            archive_rand01(&env->rng));
+  uint32_t best_steps;
+  if (cell < 0 ||
+      !archive_read(env->archive, cell, env->archive_buf, &best_steps) ||
+      !savestate_load(env->emu.core, env->archive_buf))
+    return false;
+  env->archive_base = best_steps;
+  env->archive_resets++;
+  return true;
+}
+// Offers the current state when the agent enters a new (map, badges,
+// event_sum) cell
+static inline void archive_visit(PokemonRedEnv *env) {
+  RamState *ram = &env->gstate.ram;
+  uint32_t key =
+      archive_key(ram->map_n, ram->badges, (uint32_t)env->prev_event_sum);
+  if (key == env->archive_key)
+    return;
+  env->archive_key = key;
+  archive_offer(env->archive, key, env->archive_base + env->step_count,
+                env->emu.core);
+}
+// Fewer frames per unit of game progress: the options byte skips battle
+// animations and the switch prompt, and wd730 bit 6 is the game's own
+// "print without letter delay" flag. Scripts clear that bit again, so
+// instant_text re-sets it before each step instead of patching the ROM.
+static inline void apply_game_options(PokemonRedEnv *env) {
+  if (env->fast_options)
+    write_mem(&env->emu, PKMN_OPTIONS_ADDR, PKMN_OPTIONS_FAST);
+}
+static inline void apply_instant_text(PokemonRedEnv *env) {
+  uint8_t d730 = read_wram_live(&env->emu, PKMN_D730_ADDR);
+  if (!(d730 & PKMN_D730_INSTANT_TEXT))
+    write_mem(&env->emu, PKMN_D730_ADDR, d730 | PKMN_D730_INSTANT_TEXT);
+}
 void c_reset(PokemonRedEnv *env) {
   if (!env || !env->emu.core)
     return;
-  if (env->full_reset) {
-    initial_load_state(&env->emu, env->emu.state_path);
+  bool from_state_file = false;
+  if (!archive_reset(env)) {
+    // Without full_reset the trajectory carries on from where it stopped
+    env->archive_base =
+        env->full_reset ? 0 : env->archive_base + (uint32_t)env->step_count;
+    if (env->full_reset && !mgba_restore_cached_state(&env->emu))
+      initial_load_state(&env->emu, env->emu.state_path);
+    from_state_file = env->full_reset;
   }
+  apply_game_options(env);
+  env->archive_key = UINT32_MAX;
   RamState *ram = &env->gstate.ram;
   update_ram(env);
 
@@ -367,44 +721,237 @@ void c_reset(PokemonRedEnv *env) {
   env->score = 0.0f;
   env->stagnation = 0;
   env->unique_coords_count = 1;
-  env->prev_event_sum = calc_event_sum(&env->emu, NULL);
-  // Initialize prev_events to current state without printing
-  for (size_t i = 0; i < EVENT_COUNT; ++i) {
-    uint8_t value = read_mem(&env->emu, EVENT_LIST[i].address);
-    env->prev_events[i] = (value >> EVENT_LIST[i].bit) & 1;
+  // Event baselines only exist when the event term is computed
+  env->prev_event_sum = 0;
+  if (env->reward_components & REWARD_EVENT) {
+    env->prev_event_sum = calc_event_sum(env, false);
+    read_event_flags(&env->emu, env->prev_events);
   }
 
-  for (int i = 0; i < 4; i++)
-    env->emu.core->runFrame(env->emu.core);
+  struct mCore *core = env->emu.core;
+  uint32_t settle_keys = env->recorder ? core->getKeys(core) : 0;
+  for (int i = 0; i < RESET_SETTLE_FRAMES; i++)
+    core->runFrame(core);
+  // A replay rebuilds state-file starts itself; anything else needs the state
+  if (env->recorder)
+    record_segment(env->recorder, core, 0,
+                   from_state_file ? RECORD_FROM_STATE_FILE
+                                   : RECORD_FROM_KEYFRAME,
+                   settle_keys, RESET_SETTLE_FRAMES);
+}
+// Episode bookkeeping saved next to the core savestate; the current
+// observation follows it so a restored env needs no extra frame to render
+typedef struct {
+  GameState gstate;
+  int32_t frame_count;
+  int32_t step_count;
+  int32_t stagnation;
+  int32_t prev_event_sum;
+  uint32_t unique_coords_count;
+  uint32_t archive_key;  // so archive_visit credits the snapshot's cell
+  uint32_t archive_base; // and counts best_steps from its episode start
+  float score;
+  uint8_t prev_events[EVENT_MASK_COUNT];
+} EnvSnapshot;
+
+static inline size_t obs_bytes(const PokemonRedEnv *env) {
+  if (env->obs_mode == OBS_MODE_TILEMAP)
+    return TILEMAP_OBSERVATIONS;
+  return TOTAL_OBSERVATIONS *
+         (env->obs_mode == OBS_MODE_FLOAT ? sizeof(float) : sizeof(uint8_t));
+}
+static inline size_t snapshot_env_size(const PokemonRedEnv *env) {
+  return sizeof(EnvSnapshot) + obs_bytes(env);
+}
+bool c_snapshot(PokemonRedEnv *env, const SnapshotArena *arena,
+                Snapshot *snap) {
+  if (!env || !env->emu.core ||
+      savestate_size(env->emu.core) != arena->state_size ||
+      snapshot_env_size(env) != arena->env_size)
+    return false;
+  if (!savestate_save(env->emu.core, snapshot_state(arena, snap)))
+    return false;
+  EnvSnapshot *saved = (EnvSnapshot *)snapshot_env(arena, snap);
+  saved->gstate = env->gstate;
+  saved->frame_count = env->frame_count;
+  saved->step_count = env->step_count;
+  saved->stagnation = env->stagnation;
+  saved->prev_event_sum = env->prev_event_sum;
+  saved->unique_coords_count = env->unique_coords_count;
+  saved->archive_key = env->archive_key;
+  saved->archive_base = env->archive_base;
+  saved->score = env->score;
+  memcpy(saved->prev_events, env->prev_events, EVENT_MASK_COUNT);
+  memcpy(saved + 1, env->observations, obs_bytes(env));
+  visited_copy(&snap->visited, &env->visited_coords);
+  visited_copy(&snap->prev_visited, &env->prev_visited_coords);
+  return true;
+}
+// Puts the env back exactly where c_snapshot found it, mid-episode: the next
+// c_step continues from the saved step_count and reward baselines
+bool c_restore(PokemonRedEnv *env, const SnapshotArena *arena,
+               const Snapshot *snap) {
+  if (!env || !env->emu.core ||
+      savestate_size(env->emu.core) != arena->state_size ||
+      snapshot_env_size(env) != arena->env_size)
+    return false;
+  if (!savestate_load(env->emu.core, snapshot_state(arena, snap)))
+    return false;
+  mgba_snapshot_wram(&env->emu);
+  const EnvSnapshot *saved = (const EnvSnapshot *)snapshot_env(arena, snap);
+  env->gstate = saved->gstate;
+  env->frame_count = saved->frame_count;
+  env->step_count = saved->step_count;
+  env->stagnation = saved->stagnation;
+  env->prev_event_sum = saved->prev_event_sum;
+  env->unique_coords_count = saved->unique_coords_count;
+  env->archive_key = saved->archive_key;
+  env->archive_base = saved->archive_base;
+  env->score = saved->score;
+  memcpy(env->prev_events, saved->prev_events, EVENT_MASK_COUNT);
+  memcpy(env->observations, saved + 1, obs_bytes(env));
+  visited_copy(&env->visited_coords, &snap->visited);
+  visited_copy(&env->prev_visited_coords, &snap->prev_visited);
+  env->rewards[0] = 0;
+  env->terminals[0] = 0;
+  if (env->recorder)
+    record_segment(env->recorder, env->emu.core, (uint32_t)env->step_count,
+                   RECORD_FROM_KEYFRAME, 0, 0);
+  return true;
+}
+// Starts recording this env to `path`; the header keeps everything that
+// decides how an action byte turns into frames
+bool c_record_open(PokemonRedEnv *env, const char *path,
+                   uint32_t keyframe_interval) {
+  if (!env || !env->emu.core || env->recorder)
+    return false;
+  RecordHeader config = {0};
+  config.state_size = (uint32_t)savestate_size(env->emu.core);
+  config.frame_skip = env->emu.frame_skip;
+  config.max_frameskip = env->max_frameskip;
+  config.adaptive_frameskip = env->adaptive_frameskip;
+  config.macro_actions = env->macro_actions;
+  config.fast_options = env->fast_options;
+  config.instant_text = env->instant_text;
+  config.env_id = env->env_id;
+  snprintf(config.state_path, sizeof(config.state_path), "%s",
+           env->emu.state_path);
+  Recorder *rec = (Recorder *)calloc(1, sizeof(Recorder));
+  if (!rec || !record_open(rec, path, &config, keyframe_interval)) {
+    free(rec);
+    return false;
+  }
+  env->recorder = rec;
+  return true;
+}
+// True while the game would drop the agent's input: scripted movement,
+// simulated joypad, every button masked, or mid-way through a walk step
+static inline bool input_ignored(PokemonRedEnv *env) {
+  mGBA *emu = &env->emu;
+  return read_wram_live(emu, PKMN_JOY_IGNORE_ADDR) == 0xFF ||
+         (read_wram_live(emu, PKMN_D730_ADDR) & PKMN_D730_NO_INPUT) ||
+         read_wram_live(emu, PKMN_WALK_COUNTER_ADDR) != 0;
+}
+// Runs one step's frames (frameskip frames of one button, or a whole macro
+// sequence) and returns how many were emulated. With lazy_render the PPU
+// only draws the last of those frames, the one update_observations reads;
+// tilemap observations come from VRAM, so headless tilemap envs draw none.
+// Adaptive mode continues with keys released until input matters again (or
+// the cap), so the policy is not queried for steps it cannot influence;
+// those frames render normally since any of them may end the step.
+static inline int run_step_frames(PokemonRedEnv *env, int action) {
+  struct mCore *core = env->emu.core;
+  const MacroSequence *macro =
+      env->macro_actions ? macro_for_action(action) : NULL;
+  int frames = macro                     ? macro->length
+               : env->emu.frame_skip > 0 ? env->emu.frame_skip
+                                         : 1;
+  bool pixels = env->obs_mode != OBS_MODE_TILEMAP || env->emu.render_enabled;
+  int dark = !pixels            ? frames
+             : env->lazy_render ? frames - 1
+                                : 0; // frames nobody looks at
+  if (dark > 0)
+    mgba_set_video_layers(&env->emu, false);
+  if (macro) {
+    STEP_N_FRAMES_VARIED(core, macro->keys, dark);
+    mgba_set_video_layers(&env->emu, pixels);
+    STEP_N_FRAMES_VARIED(core, macro->keys + dark, frames - dark);
+  } else {
+    uint32_t keys = action_to_key(action);
+    STEP_N_FRAMES(core, keys, dark);
+    mgba_set_video_layers(&env->emu, pixels);
+    STEP_N_FRAMES(core, keys, frames - dark);
+  }
+  if (env->adaptive_frameskip) {
+    core->setKeys(core, 0);
+    while (frames < env->max_frameskip && input_ignored(env)) {
+      core->runFrame(core);
+      frames++;
+    }
+  }
+  return frames;
+}
+// Everything c_step does to the emulator for one action, shared with
+// pokered_replay so a recording replays frame for frame
+static inline int emulate_step(PokemonRedEnv *env, int action) {
+  if (env->instant_text)
+    apply_instant_text(env);
+  return run_step_frames(env, action);
+}
+static inline void write_telemetry(PokemonRedEnv *env) {
+  const RamState *ram = &env->gstate.ram;
+  int16_t *row = env->telemetry;
+  row[TELEMETRY_X] = ram->x;
+  row[TELEMETRY_Y] = ram->y;
+  row[TELEMETRY_MAP] = ram->map_n;
+  row[TELEMETRY_BADGES] = ram->badges;
+  row[TELEMETRY_EVENTS] = (int16_t)env->prev_event_sum;
 }
 void c_step(PokemonRedEnv *env) {
   if (!env || !env->emu.core)
     return;
+  PERF_START(step);
   env->rewards[0] = 0;
   env->terminals[0] = 0;
   env->step_count++;
   // batch frame stepping
-  int skip = env->emu.frame_skip > 0 ? env->emu.frame_skip : 1;
-  uint32_t action_key = action_to_key(env->actions[0]);
-  STEP_N_FRAMES(env->emu.core, action_key, skip);
-  env->frame_count += skip;
+  PERF_START(emulate);
+  int frames = emulate_step(env, env->actions[0]);
+  PERF_END(&env->perf, emulate, PERF_EMULATE);
+  if (env->recorder)
+    record_step(env->recorder, env->emu.core, (uint32_t)env->step_count,
+                (uint8_t)env->actions[0]);
+  env->frame_count += frames;
+  env->last_step_frames = frames;
 
   //  update_battle_state(&env->gstate.battle, &env->emu);
   //  if (env->gstate.battle.battle_active) {
   //    env->step_count++;
   //  }
 
-  float reward = calculate_rewards(env);
+  float reward = env->reward_fn(env);
+  if (env->archive)
+    archive_visit(env);
+  if (env->telemetry)
+    write_telemetry(env);
+  PERF_START(obs);
   update_observations(env);
+  PERF_END(&env->perf, obs, PERF_OBS);
   env->rewards[0] = reward;
   env->score += reward;
 
   if (env->step_count >= env->max_episode_length) {
     env->terminals[0] = 1;
+    PERF_START(log);
     add_log(env);
-    memcpy(env->prev_visited_coords, env->visited_coords, VISITED_COORDS_SIZE);
+    PERF_END(&env->perf, log, PERF_LOG);
+    // This episode becomes "previous"; c_reset clears the old previous set
+    visited_swap(&env->prev_visited_coords, &env->visited_coords);
+    PERF_START(reset);
     c_reset(env);
+    PERF_END(&env->perf, reset, PERF_RESET);
   }
+  PERF_STEP(&env->perf, step, frames);
 }
 void c_render(PokemonRedEnv *env) { mgba_render_frame(&env->emu); }
 void c_close(PokemonRedEnv *env) {
@@ -420,15 +967,38 @@ void c_close(PokemonRedEnv *env) {
     env->emu.core = NULL;
   }
 
+  mgba_release_cached_state(&env->emu);
+
   if (env->emu.uses_shared_rom) {
     release_shared_rom();
     env->emu.uses_shared_rom = false;
   }
 
   if (env->emu.video_buffer) {
-    free(env->emu.video_buffer);
+    arena_free(&env->arena, env->emu.video_buffer);
     env->emu.video_buffer = NULL;
   }
+
+  visited_free(&env->visited_coords);
+  visited_free(&env->prev_visited_coords);
+
+  if (env->archive) {
+    archive_close(env->archive);
+    env->archive = NULL;
+  }
+  arena_free(&env->arena, env->archive_buf);
+  env->archive_buf = NULL;
+
+  if (env->visit_map) {
+    visitmap_close(env->visit_map);
+    env->visit_map = NULL;
+  }
+
+  if (env->recorder) {
+    record_close(env->recorder);
+    free(env->recorder);
+    env->recorder = NULL;
+  }
 }
 
 #endif // POKEMONREDENV_H
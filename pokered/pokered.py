@@ -1,9 +1,11 @@
 import numpy as np
 import threading
 import json
+import os
 import multiprocessing
 from gymnasium import spaces
 import pufferlib
+import pufferlib.vector
 from pokered import binding
 import uuid
 
@@ -17,6 +19,27 @@ STREAM_COLOR_PURPLE = "#800080"
 STREAM_COLOR_PINK = "#FF00FF"
 STREAM_COLOR_YELLOW = "#DAEE01"
 
+# obs_mode -> (binding ObsMode, observation dtype)
+OBS_MODES = {
+    'float32': (0, np.float32),
+    'uint8': (1, np.uint8),  # 4x smaller obs buffer, SIMD downsample kernel
+    'packed': (2, np.uint8),  # full-res 2-bit shades, see models.unpack_2bpp
+    'tilemap': (3, np.uint8),  # VRAM tile indices + OAM, see models.TilemapEncoder
+}
+
+# OBS_MODE_TILEMAP layout (includes/obs.h): 20x18 tile indices, 40 OAM entries
+TILEMAP_ROWS = 18
+TILEMAP_COLS = 20
+TILEMAP_SPRITES = 40
+TILEMAP_BYTES = TILEMAP_ROWS * TILEMAP_COLS + 4 * TILEMAP_SPRITES
+
+# Per-env row written by C while streaming (TELEMETRY_* in pokered.h)
+TELEMETRY_FIELDS = 5  # x, y, map_n, badges, event_sum
+
+# Single buttons (noop + 8) and the sequences in includes/macro_actions.h
+NUM_BUTTON_ACTIONS = 9
+NUM_MACRO_ACTIONS = 8
+
 WS_URL = "wss://transdimensional.xyz/broadcast" # "ws://localhost:3344/broadcast" #
 
 
@@ -28,7 +51,19 @@ class PokemonRed(pufferlib.PufferEnv):
     def __init__(self, num_envs=1, render_mode=None, headless=False, rom_path=None, state_path=None,
                  frameskip=4, max_episode_length=20480, continuous=False, log_interval=128,
                  stream_enabled=False, stream_user=None, stream_color=None, stream_extra=None, full_reset=True,
-                 stream_interval=500, buf=None, seed=0):
+                 stream_interval=500, num_threads=0, pin_threads=False, num_buffers=1,
+                 obs_mode='float32', init_threads=0, clone_from_template=False,
+                 adaptive_frameskip=False, max_frameskip=64, macro_actions=False,
+                 lazy_render=False, fast_options=False, instant_text=False,
+                 archive_cells=0, archive_name=None, state_cache_name=None,
+                 archive_reset_prob=0.5, archive_alpha=0.5,
+                 visit_map_blocks=0, visit_map_name=None, novelty_scale=0.0,
+                 record_dir=None, record_keyframe_interval=2048,
+                 env_arenas=False, huge_pages=False,
+                 reward_components='all', event_scan_interval=1,
+                 reward_badge=5.0, reward_pokemon=1.0, reward_coord=0.005,
+                 reward_level=0.5, reward_event=0.1,
+                 buf=None, seed=0):
         with PokemonRed.counter_lock:
             env_id = PokemonRed.counter.value
             PokemonRed.counter.value += 1
@@ -42,25 +77,72 @@ class PokemonRed(pufferlib.PufferEnv):
         self.continuous = continuous
         self.log_interval = log_interval
         self.tick = 0
+        # num_buffers=2: send/recv alternate between two halves of the envs so
+        # one half emulates while the policy runs on the other
+        if num_buffers < 1 or num_envs % num_buffers != 0:
+            raise pufferlib.APIUsageError('num_envs must be divisible by num_buffers')
+        self.num_buffers = num_buffers
+        self.buffer_slices = [
+            slice(b * num_envs // num_buffers, (b + 1) * num_envs // num_buffers)
+            for b in range(num_buffers)
+        ]
+        self.buffer_ticks = [0] * num_buffers
 
         self.screen_width = 160
         self.screen_height = 144
         self.scaled_width = 80
         self.scaled_height = 72
+        if obs_mode not in OBS_MODES:
+            raise pufferlib.APIUsageError(
+                f'obs_mode must be one of {list(OBS_MODES)}, got {obs_mode!r}')
+        self.obs_mode = obs_mode
+        if obs_mode == 'tilemap':
+            obs_size = TILEMAP_BYTES + 5  # 360 + 160 + 5 = 525
+        else:
+            obs_size = self.scaled_height * self.scaled_width + 5  # 80*72 + 5 = 5765
         self.single_observation_space = spaces.Box(
             low=0, high=255,
-            shape=(self.scaled_height * self.scaled_width + 5,),  # 80*72 + 5 = 5765
-            dtype=np.float32
+            shape=(obs_size,),
+            dtype=OBS_MODES[obs_mode][1]
         )
-        self.single_action_space = spaces.Discrete(9)
+        self.single_action_space = spaces.Discrete(
+            NUM_BUTTON_ACTIONS + (NUM_MACRO_ACTIONS if macro_actions else 0))
         
         super().__init__(buf)
-        
+
+        # One .prr trajectory file per env, replayed with pokered_replay
+        if record_dir:
+            os.makedirs(record_dir, exist_ok=True)
+        # Pinned pools of sibling workers start at different CPUs
+        worker_index, num_workers = pufferlib.vector.WORKER_SLOT
+
         self.c_envs = binding.vec_init(
             self.observations, self.actions, self.rewards,
             self.terminals, self.truncations, num_envs, seed, 
             headless=headless, rom_path=rom_path, state_path=state_path,
-            frameskip=frameskip, max_episode_length=max_episode_length, full_reset=full_reset
+            frameskip=frameskip, max_episode_length=max_episode_length, full_reset=full_reset,
+            num_threads=num_threads, pin_threads=pin_threads, num_buffers=num_buffers,
+            worker_index=worker_index, num_workers=num_workers,
+            env_arenas=env_arenas, huge_pages=huge_pages,
+            reward_components=reward_components,
+            event_scan_interval=event_scan_interval,
+            reward_badge=reward_badge, reward_pokemon=reward_pokemon,
+            reward_coord=reward_coord, reward_level=reward_level,
+            reward_event=reward_event,
+            obs_mode=OBS_MODES[obs_mode][0], init_threads=init_threads,
+            clone_from_template=clone_from_template,
+            adaptive_frameskip=adaptive_frameskip, max_frameskip=max_frameskip,
+            macro_actions=macro_actions, lazy_render=lazy_render,
+            fast_options=fast_options, instant_text=instant_text,
+            archive_cells=archive_cells, archive_reset_prob=archive_reset_prob,
+            archive_alpha=archive_alpha,
+            # run_id is inherited by forked workers, so they all join one segment
+            archive_name=archive_name or f'pokered_archive_{run_id}',
+            state_cache_name=state_cache_name or f'pokered_state_{run_id}',
+            visit_map_blocks=visit_map_blocks, novelty_scale=novelty_scale,
+            visit_map_name=visit_map_name or f'pokered_visits_{run_id}',
+            record_dir=record_dir or None,
+            record_keyframe_interval=record_keyframe_interval
         )
         
         self.stream_enabled = stream_enabled
@@ -68,11 +150,18 @@ class PokemonRed(pufferlib.PufferEnv):
         self.stream_color = stream_color[0] or STREAM_COLOR_PURPLE
         self.stream_extra = str(stream_extra)
         self.stream_interval = int(stream_interval)
-        self.coords = [[] for _ in range(num_envs)]
         self._ws = None
         self._stream_thread = None
         
         if stream_enabled:
+            # C overwrites telemetry every step; steps are appended to a
+            # per-env ring (sized for double-buffer tick skew) and turned into
+            # Python lists only when _broadcast actually sends them
+            self.telemetry = np.zeros((num_envs, TELEMETRY_FIELDS), dtype=np.int16)
+            binding.vec_telemetry_init(self.c_envs, self.telemetry)
+            self.coord_ring = np.zeros((2 * self.stream_interval, num_envs, 3), dtype=np.int16)
+            self.coord_count = np.zeros(num_envs, dtype=np.int64)
+            self.agent_index = np.arange(num_envs)
             self._start_stream()
     
     def _start_stream(self):
@@ -100,45 +189,41 @@ class PokemonRed(pufferlib.PufferEnv):
             print(f"Stream reconnection failed: {e}")
             return False
     
+    def _coord_messages(self):
+        messages = []
+        for i in np.flatnonzero(self.coord_count):
+            coords = self.coord_ring[:self.coord_count[i], i]
+            coords = coords[coords.any(axis=1)]
+            if len(coords):
+                messages.append(json.dumps({
+                    "metadata": {
+                        "user": self.stream_user + "\n",
+                        "color": self.stream_color,
+                        "extra": self.stream_extra + "\n", # self.stream_extra,
+                        "env_id": f"{run_id}:{self.env_id}:{i+1}\n"
+                    },
+                    "coords": coords.tolist()
+                }))
+        self.coord_count[:] = 0
+        return messages
+
     def _broadcast(self):
         if not self._ws:
             if self.stream_enabled:
                 self._reconnect_stream()
             return
+        messages = self._coord_messages()
         try:
-            for i, coord_list in enumerate(self.coords):
-                if coord_list: 
-                    msg = json.dumps({
-                        "metadata": {
-                            "user": self.stream_user + "\n",
-                            "color": self.stream_color,
-                            "extra": self.stream_extra + "\n", # self.stream_extra,
-                            "env_id": f"{run_id}:{self.env_id}:{i+1}\n"
-                        },
-                        "coords": coord_list
-                    })
-                    self._ws.send(msg)
-            self.coords = [[] for _ in range(self.num_agents)]
+            for msg in messages:
+                self._ws.send(msg)
         except Exception as e:
             # print(f"Stream error: {e}, attempting reconnect...")
             if self._reconnect_stream():
                 try:
-                    for i, coord_list in enumerate(self.coords):
-                        if coord_list:
-                            msg = json.dumps({
-                                "metadata": {
-                                    "user": self.stream_user + "\n",
-                                    "color": self.stream_color,
-                                    "extra": self.stream_extra + "\n",
-                                    "env_id": f"{run_id}:{self.env_id}:{i+1}\n"
-                                },
-                                "coords": coord_list
-                            })
-                            self._ws.send(msg)
-                    self.coords = [[] for _ in range(self.num_agents)]
+                    for msg in messages:
+                        self._ws.send(msg)
                 except Exception as retry_e:
                     print(f"Retry failed: {retry_e}")
-                    self.coords = [[] for _ in range(self.num_agents)]
     
     def reset(self, seed=None):
         self.tick = 0
@@ -155,11 +240,7 @@ class PokemonRed(pufferlib.PufferEnv):
         binding.vec_step(self.c_envs)
 
         if self.stream_enabled:
-            positions = binding.vec_get_positions(self.c_envs)
-            for i, (x, y, m) in enumerate(positions):
-                if x != 0 or y != 0 or m != 0:
-                    self.coords[i].append([int(x), int(y), int(m)])
-            
+            self._record_positions(slice(0, self.num_agents))
             if self.tick % self.stream_interval == 0:
                 self._broadcast()
 
@@ -170,6 +251,80 @@ class PokemonRed(pufferlib.PufferEnv):
         return (self.observations, self.rewards,
             self.terminals, self.truncations, info)
 
+    def _record_positions(self, env_slice):
+        # One vectorized copy; a full ring keeps overwriting its last row
+        rows = np.minimum(self.coord_count[env_slice], len(self.coord_ring) - 1)
+        self.coord_ring[rows, self.agent_index[env_slice]] = self.telemetry[env_slice, :3]
+        self.coord_count[env_slice] = rows + 1
+
+    @property
+    def agents_per_batch(self):
+        return self.num_agents // self.num_buffers
+
+    def async_reset(self, seed=None):
+        if self.num_buffers == 1:
+            return super().async_reset(seed)
+
+        _, self.infos = self.reset(seed)
+        self.buffer = 0
+        self.in_flight = [False] * self.num_buffers
+
+    def send(self, actions):
+        if self.num_buffers == 1:
+            return super().send(actions)
+
+        b = self.buffer
+        self.actions[self.buffer_slices[b]] = actions
+        binding.vec_send(self.c_envs, b)
+        self.in_flight[b] = True
+        self.buffer = (b + 1) % self.num_buffers
+
+    def recv(self):
+        if self.num_buffers == 1:
+            return super().recv()
+
+        b = self.buffer
+        s = self.buffer_slices[b]
+        info = []
+        if self.in_flight[b]:
+            binding.vec_recv(self.c_envs, b)
+            self.in_flight[b] = False
+            self.buffer_ticks[b] += 1
+            tick = self.buffer_ticks[b]
+
+            if self.stream_enabled:
+                self._record_positions(s)
+                if b == 0 and tick % self.stream_interval == 0:
+                    self._broadcast()
+
+            if tick % self.log_interval == 0:
+                info.append(binding.vec_log(self.c_envs, b))
+
+        return (self.observations[s], self.rewards[s], self.terminals[s],
+            self.truncations[s], info, self.agent_ids[s], self.masks[s])
+
+    def snapshot(self, env_ids=None):
+        """In-memory savestates (emulator + episode bookkeeping), one handle per env"""
+        if env_ids is None:
+            env_ids = range(self.num_agents)
+        return binding.vec_snapshot(self.c_envs, list(env_ids))
+
+    def restore(self, env_ids, handles):
+        """Resume envs mid-episode from snapshot handles; observations are refreshed"""
+        binding.vec_restore(self.c_envs, list(env_ids), list(handles))
+
+    def release(self, handles):
+        binding.vec_release(list(handles))
+
+    def visit_map(self):
+        """Node-wide visit counts shared by every worker, or None if disabled.
+        Returns (directory, counts) numpy views of the shm segment: directory
+        is indexed by map << 8 | (x // 16) << 4 | (y // 16) and holds a block
+        index + 1 (0 = never visited); counts[block - 1][y % 16][x % 16] is
+        the number of times any env entered that tile. Views are live, and
+        they keep the segment mapped while referenced, even after close()."""
+        return binding.vec_visit_map(self.c_envs)
+
     def render(self):
         binding.vec_render(self.c_envs, 0)
 
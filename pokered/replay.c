@@ -0,0 +1,439 @@
+// replay.c - Native replayer for record_dir trajectory files
+// Rebuilds an env from a .prr header, then either checks every segment
+// headless (each keyframe passed on the way must match the replayed state),
+// or seeks to one step of one segment from its nearest keyframe and saves
+// the state there and/or renders the rest of the segment in a window.
+//
+//   ./pokered_replay -l runs/pokered_1234_0.prr
+//   ./pokered_replay -g 3 -t 15000 -w runs/pokered_1234_0.prr
+#include "pokered.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  uint64_t begin; // offset of the segment chunk
+  uint64_t end;   // offset of the next segment chunk or the data end
+  RecordSegment info;
+  uint64_t hash; // start state
+  uint32_t start_step;
+  uint32_t end_step;
+  uint32_t keyframes;
+} ReplaySegment;
+
+typedef struct {
+  const uint8_t *map;
+  size_t map_size;
+  const RecordHeader *header;
+  uint64_t length; // valid chunk bytes
+  ReplaySegment *segments;
+  int num_segments;
+  uint8_t *state_buf;
+  uint8_t *actions; // decoded chunk
+  uint32_t actions_cap;
+  int action_space;
+} Replay;
+
+// Position in a segment: the next chunk to read and the decoded actions
+typedef struct {
+  uint64_t offset;
+  uint32_t step;
+  uint32_t chunk_step; // step of actions[0]
+  uint32_t chunk_len;
+  uint64_t frames;
+  int desyncs;
+} ReplayCursor;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static bool replay_open(Replay *r, const char *path) {
+  memset(r, 0, sizeof(*r));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(RecordHeader))
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+  r->map = (const uint8_t *)map;
+  r->map_size = (size_t)st.st_size;
+  r->header = (const RecordHeader *)map;
+  if (r->header->magic != RECORD_MAGIC ||
+      r->header->version != RECORD_VERSION) {
+    fprintf(stderr, "%s is not a version %d recording\n", path,
+            RECORD_VERSION);
+    return false;
+  }
+  // A live or crashed recording can be longer on disk than its valid chunks
+  r->length = r->header->length < r->map_size ? r->header->length
+                                              : (uint64_t)r->map_size;
+  r->state_buf = (uint8_t *)malloc(r->header->state_size);
+  r->action_space = r->header->macro_actions ? MACRO_ACTION_SPACE
+                                             : GB_ACTION_COUNT;
+  if (!r->state_buf)
+    return false;
+
+  uint64_t offset = sizeof(RecordHeader), at = offset;
+  const RecordChunk *chunk;
+  ReplaySegment *seg = NULL;
+  while ((chunk = record_next(r->map, r->length, &offset))) {
+    if (chunk->type == RECORD_SEGMENT) {
+      ReplaySegment *segments = (ReplaySegment *)realloc(
+          r->segments, (r->num_segments + 1) * sizeof(ReplaySegment));
+      if (!segments)
+        return false;
+      r->segments = segments;
+      seg = &r->segments[r->num_segments++];
+      memset(seg, 0, sizeof(*seg));
+      seg->begin = at;
+      seg->hash = chunk->hash;
+      seg->start_step = seg->end_step = chunk->step;
+      if (chunk->raw_bytes != sizeof(RecordSegment) ||
+          !record_payload(chunk, (uint8_t *)&seg->info))
+        return false;
+    } else if (seg && chunk->type == RECORD_ACTIONS) {
+      seg->end_step = chunk->step + chunk->raw_bytes;
+      if (chunk->raw_bytes > r->actions_cap)
+        r->actions_cap = chunk->raw_bytes;
+    } else if (seg && chunk->type == RECORD_KEYFRAME) {
+      seg->keyframes++;
+    }
+    if (seg)
+      seg->end = offset;
+    at = offset;
+  }
+  r->actions = (uint8_t *)malloc(r->actions_cap ? r->actions_cap : 1);
+  return r->actions != NULL;
+}
+
+static void replay_close(Replay *r) {
+  if (r->map)
+    munmap((void *)r->map, r->map_size);
+  free(r->segments);
+  free(r->state_buf);
+  free(r->actions);
+  memset(r, 0, sizeof(*r));
+}
+
+// The recording's step config, then the shared construction. Observations
+// are never read, so the PPU only draws when there is a window to show.
+// Segments that start from state_path reset from the cached blob.
+static int replay_init_env(PokemonRedEnv *env, const RecordHeader *header,
+                           const char *rom_path, const char *state_path,
+                           bool window) {
+  env->env_id = header->env_id;
+  env->emu.frame_skip = header->frame_skip;
+  env->adaptive_frameskip = header->adaptive_frameskip;
+  env->max_frameskip = header->max_frameskip;
+  env->macro_actions = header->macro_actions;
+  env->fast_options = header->fast_options;
+  env->instant_text = header->instant_text;
+  env->obs_mode = OBS_MODE_TILEMAP;
+  env->emu.render_enabled = window;
+  strncpy(env->emu.rom_path, rom_path, sizeof(env->emu.rom_path) - 1);
+  strncpy(env->emu.state_path, state_path, sizeof(env->emu.state_path) - 1);
+  env->full_reset = true;
+
+  if (pokered_init_env(env) != 0)
+    return -1;
+  if (savestate_size(env->emu.core) != header->state_size) {
+    fprintf(stderr, "Savestate size %zu does not match the recording (%u)\n",
+            savestate_size(env->emu.core), header->state_size);
+    return -1;
+  }
+  return 0;
+}
+
+static uint64_t replay_hash_state(Replay *r, PokemonRedEnv *env) {
+  struct mCore *core = env->emu.core;
+  if (!savestate_save(core, r->state_buf))
+    return 0;
+  return record_hash(r->state_buf, r->header->state_size);
+}
+
+static bool replay_load_keyframe(Replay *r, PokemonRedEnv *env,
+                                 const RecordChunk *chunk) {
+  if (chunk->raw_bytes != r->header->state_size ||
+      !record_payload(chunk, r->state_buf) ||
+      !savestate_load(env->emu.core, r->state_buf))
+    return false;
+  mgba_snapshot_wram(&env->emu);
+  return true;
+}
+
+// Puts the env at the segment's nearest state at or before `target`
+static bool replay_seek(Replay *r, PokemonRedEnv *env, const ReplaySegment *seg,
+                        uint32_t target, ReplayCursor *cur) {
+  memset(cur, 0, sizeof(*cur));
+  uint64_t offset = seg->begin;
+  const RecordChunk *chunk, *best = NULL;
+  uint64_t best_next = 0;
+  while (offset < seg->end && (chunk = record_next(r->map, r->length, &offset))) {
+    if (chunk->type == RECORD_KEYFRAME && chunk->step <= target &&
+        (!best || chunk->step >= best->step)) {
+      best = chunk;
+      best_next = offset;
+    }
+  }
+
+  if (best) {
+    if (!replay_load_keyframe(r, env, best)) {
+      fprintf(stderr, "Corrupt keyframe at step %u\n", best->step);
+      return false;
+    }
+    cur->offset = best_next;
+    cur->step = best->step;
+    return true;
+  }
+  if (seg->info.origin != RECORD_FROM_STATE_FILE) {
+    fprintf(stderr, "Segment has no keyframe for its start\n");
+    return false;
+  }
+  // Same sequence as c_reset: state file, options, settle frames
+  struct mCore *core = env->emu.core;
+  if (!mgba_restore_cached_state(&env->emu))
+    initial_load_state(&env->emu, env->emu.state_path);
+  apply_game_options(env);
+  core->setKeys(core, seg->info.settle_keys);
+  for (uint32_t i = 0; i < seg->info.settle_frames; i++)
+    core->runFrame(core);
+  if (replay_hash_state(r, env) != seg->hash) {
+    fprintf(stderr, "Start state does not match %s (different state file or "
+                    "ROM?)\n",
+            env->emu.state_path);
+    return false;
+  }
+  offset = seg->begin;
+  record_next(r->map, r->length, &offset); // past the segment chunk
+  cur->offset = offset;
+  cur->step = seg->start_step;
+  return true;
+}
+
+// Steps until `until` (or the segment end). Keyframes passed on the way are
+// compared with the replayed state; on a mismatch the replay continues from
+// the keyframe. With a window every step is drawn at ~60 frames per second.
+static bool replay_run(Replay *r, PokemonRedEnv *env, const ReplaySegment *seg,
+                       ReplayCursor *cur, uint32_t until, bool render) {
+  while (cur->step < until) {
+    if (cur->step >= cur->chunk_step + cur->chunk_len) {
+      const RecordChunk *chunk = NULL;
+      if (cur->offset < seg->end)
+        chunk = record_next(r->map, r->length, &cur->offset);
+      if (!chunk)
+        return true; // segment ends before `until`
+      if (chunk->type == RECORD_KEYFRAME && chunk->step == cur->step) {
+        if (replay_hash_state(r, env) != chunk->hash) {
+          fprintf(stderr, "Desync at step %u, resuming from its keyframe\n",
+                  cur->step);
+          cur->desyncs++;
+          if (!replay_load_keyframe(r, env, chunk))
+            return false;
+        }
+        continue;
+      }
+      if (chunk->type != RECORD_ACTIONS)
+        continue;
+      if (chunk->step + chunk->raw_bytes <= cur->step)
+        continue; // before a keyframe we started from
+      if (chunk->step > cur->step || !record_payload(chunk, r->actions)) {
+        fprintf(stderr, "Corrupt action chunk at step %u\n", chunk->step);
+        return false;
+      }
+      cur->chunk_step = chunk->step;
+      cur->chunk_len = chunk->raw_bytes;
+    }
+    int action = r->actions[cur->step - cur->chunk_step];
+    if (action >= r->action_space) {
+      fprintf(stderr, "Invalid action %d at step %u\n", action, cur->step);
+      return false;
+    }
+    int frames = emulate_step(env, action);
+    cur->frames += (uint64_t)frames;
+    cur->step++;
+    if (render) {
+      c_render(env);
+      if (!env->emu.render_enabled)
+        return true; // window closed
+      SDL_Delay((Uint32)(frames * 1000 / 60));
+    }
+  }
+  return true;
+}
+
+static const char *origin_name(uint32_t origin) {
+  return origin == RECORD_FROM_STATE_FILE ? "state file" : "keyframe";
+}
+
+static void list_segments(const Replay *r) {
+  const RecordHeader *h = r->header;
+  printf("env %d, state %s, frameskip %d%s%s%s%s, keyframe every %u steps, "
+         "state %u bytes, %llu bytes recorded\n",
+         h->env_id, h->state_path, h->frame_skip,
+         h->adaptive_frameskip ? " (adaptive)" : "",
+         h->macro_actions ? " macro" : "", h->fast_options ? " fast-options" : "",
+         h->instant_text ? " instant-text" : "", h->keyframe_interval,
+         h->state_size, (unsigned long long)r->length);
+  for (int i = 0; i < r->num_segments; i++) {
+    const ReplaySegment *seg = &r->segments[i];
+    printf("  segment %4d: steps %6u-%-6u from %-10s %3u keyframes %8llu "
+           "bytes\n",
+           i, seg->start_step, seg->end_step, origin_name(seg->info.origin),
+           seg->keyframes, (unsigned long long)(seg->end - seg->begin));
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options] FILE.prr\n"
+          "  -l, --list            list the recorded segments\n"
+          "  -g, --segment N       seek in segment N (default: check all)\n"
+          "  -t, --step T          step to seek to (default: segment end)\n"
+          "  -o, --out PATH        save the state at the seek target\n"
+          "  -w, --window          render from the seek target to the end\n"
+          "      --rom PATH        ROM (default ./pokemon_red.gb)\n"
+          "      --state PATH      state file (default: the recorded path)\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  bool list = false, window = false;
+  int segment = -1;
+  long target = -1;
+  const char *out_path = NULL;
+  const char *rom_path = "./pokemon_red.gb";
+  const char *state_path = NULL;
+  static const struct option options[] = {
+      {"list", no_argument, NULL, 'l'},
+      {"segment", required_argument, NULL, 'g'},
+      {"step", required_argument, NULL, 't'},
+      {"out", required_argument, NULL, 'o'},
+      {"window", no_argument, NULL, 'w'},
+      {"rom", required_argument, NULL, 1},
+      {"state", required_argument, NULL, 2},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "lg:t:o:wh", options, NULL)) != -1) {
+    switch (opt) {
+    case 'l':
+      list = true;
+      break;
+    case 'g':
+      segment = atoi(optarg);
+      break;
+    case 't':
+      target = atol(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'w':
+      window = true;
+      break;
+    case 1:
+      rom_path = optarg;
+      break;
+    case 2:
+      state_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1 || ((out_path || window || target >= 0) && segment < 0)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Replay r;
+  if (!replay_open(&r, argv[optind])) {
+    fprintf(stderr, "Could not read recording: %s\n", argv[optind]);
+    replay_close(&r);
+    return 1;
+  }
+  if (list) {
+    list_segments(&r);
+    replay_close(&r);
+    return 0;
+  }
+  if (segment >= r.num_segments) {
+    fprintf(stderr, "Recording has %d segments\n", r.num_segments);
+    replay_close(&r);
+    return 1;
+  }
+
+  PokemonRedEnv env = {0};
+  if (replay_init_env(&env, r.header, rom_path,
+                      state_path ? state_path : r.header->state_path,
+                      window) != 0) {
+    fprintf(stderr, "Failed to initialize the emulator\n");
+    c_close(&env);
+    replay_close(&r);
+    return 1;
+  }
+
+  int status = 0;
+  double t0 = now_sec();
+  uint64_t steps = 0, frames = 0;
+  int desyncs = 0;
+  int first = segment >= 0 ? segment : 0;
+  int last = segment >= 0 ? segment : r.num_segments - 1;
+  for (int i = first; i <= last && status == 0; i++) {
+    const ReplaySegment *seg = &r.segments[i];
+    uint32_t stop = seg->end_step;
+    if (segment >= 0 && target >= 0)
+      stop = target < (long)seg->start_step ? seg->start_step
+             : target < (long)seg->end_step ? (uint32_t)target
+                                            : seg->end_step;
+    // Checking replays each segment from its start; seeking jumps ahead
+    ReplayCursor cur;
+    bool ok = replay_seek(&r, &env, seg, segment >= 0 ? stop : seg->start_step,
+                          &cur);
+    uint32_t from = cur.step;
+    // Headless up to the target, drawn from there on
+    env.emu.render_enabled = false;
+    ok = ok && replay_run(&r, &env, seg, &cur, stop, false);
+    if (ok && out_path && !c_save_state_file(&env.emu, out_path)) {
+      fprintf(stderr, "Could not save state to %s\n", out_path);
+      ok = false;
+    }
+    if (ok && window) {
+      env.emu.render_enabled = true;
+      c_render(&env);
+      ok = replay_run(&r, &env, seg, &cur, seg->end_step, true);
+    }
+    if (!ok) {
+      fprintf(stderr, "Segment %d failed at step %u\n", i, cur.step);
+      status = 1;
+    }
+    steps += cur.step - from;
+    frames += cur.frames;
+    desyncs += cur.desyncs;
+    if (segment >= 0)
+      printf("segment %d: replayed steps %u-%u from %s%s%s\n", i, from,
+             cur.step,
+             from == seg->start_step ? origin_name(seg->info.origin)
+                                     : "keyframe",
+             out_path ? ", saved to " : "", out_path ? out_path : "");
+  }
+  double run_s = now_sec() - t0;
+  printf("%llu steps, %llu frames in %.2f s (%.0f steps/s), %d desyncs\n",
+         (unsigned long long)steps, (unsigned long long)frames, run_s,
+         run_s > 0 ? steps / run_s : 0.0, desyncs);
+
+  c_close(&env);
+  replay_close(&r);
+  return status != 0 ? status : desyncs != 0 ? 2 : 0;
+}
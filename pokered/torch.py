@@ -34,23 +34,22 @@ class PokemonRed(nn.Module):
         super().__init__()
         self.hidden_size = hidden_size
         self.is_continuous = False
-        
-        cnn_out_size = 1920 # did i match pokegym?
-        self.cnn = nn.Sequential(
-            pufferlib.pytorch.layer_init(
-                nn.Conv2d(framestack, 32, 8, stride=4)
-                ),
-            nn.ReLU(),
-            pufferlib.pytorch.layer_init(
-                nn.Conv2d(32, 64, 4, stride=2)
-                ),
-            nn.ReLU(),
-            pufferlib.pytorch.layer_init(
-                nn.Conv2d(64, 64, 3, stride=1)
-                ),
-            nn.ReLU(),
-            nn.Flatten(),
-        )
+        # 'packed' envs send the full 144x160 screen as 2-bit shades
+        obs_mode = getattr(env, 'obs_mode', 'float32')
+        self.packed = obs_mode == 'packed'
+        self.screen_shape = (144, 160) if self.packed else (72, 80)
+        self.screen_size = 72*80*1
+
+        # 'tilemap' envs send VRAM tile indices and OAM instead of pixels
+        self.tilemap = None
+        if obs_mode == 'tilemap':
+            self.tilemap = pufferlib.models.TilemapEncoder()
+            self.screen_size = self.tilemap.input_size
+            cnn_out_size = self.tilemap.output_size
+        else:
+            self.cnn = self._make_cnn(framestack)
+            with torch.no_grad():
+                cnn_out_size = self.cnn(torch.zeros(1, framestack, *self.screen_shape)).shape[1]
         
         ram_out_size = 3
         self.final = nn.Sequential(
@@ -73,6 +72,23 @@ class PokemonRed(nn.Module):
         self.value_fn = pufferlib.pytorch.layer_init(
             nn.Linear(hidden_size, 1), std=1)
 
+    def _make_cnn(self, framestack):
+        return nn.Sequential(
+            pufferlib.pytorch.layer_init(
+                nn.Conv2d(framestack, 32, 8, stride=4)
+                ),
+            nn.ReLU(),
+            pufferlib.pytorch.layer_init(
+                nn.Conv2d(32, 64, 4, stride=2)
+                ),
+            nn.ReLU(),
+            pufferlib.pytorch.layer_init(
+                nn.Conv2d(64, 64, 3, stride=1)
+                ),
+            nn.ReLU(),
+            nn.Flatten(),
+        )
+
     def forward(self, observations, state=None):
         hidden = self.encode_observations(observations)
         actions, value = self.decode_actions(hidden)
@@ -84,13 +100,21 @@ class PokemonRed(nn.Module):
     def encode_observations(self, observations, state=None):
         batch = observations.shape[0]
         # screen
-        screen_flat = observations[:, :72*80*1]
-        screen = screen_flat.view(batch, 72, 80, 1).permute(0, 3, 1, 2).float()
-        screen_norm = screen / 255.0
-        screen_net = self.cnn(screen_norm)
+        screen_flat = observations[:, :self.screen_size]
+        if self.tilemap is not None:
+            screen_net = self.tilemap(screen_flat)
+        else:
+            if self.packed:
+                # shade 0 is white, so flip to match the greyscale modes
+                shades = pufferlib.models.unpack_2bpp(screen_flat, *self.screen_shape)
+                screen_norm = (3 - shades.unsqueeze(1).float()) / 3.0
+            else:
+                screen = screen_flat.view(batch, 72, 80, 1).permute(0, 3, 1, 2).float()
+                screen_norm = screen / 255.0
+            screen_net = self.cnn(screen_norm)
 
         # ram
-        ram_flat = observations[:, 72*80*1:]
+        ram_flat = observations[:, self.screen_size:]
         coords = ram_flat[:, 0:3].float()
         coord_net = self.coord_emb(coords)
         badge = ram_flat[:, 3:4].float()
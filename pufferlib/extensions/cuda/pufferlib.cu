@@ -50,6 +50,155 @@ __global__ void puff_advantage_kernel(float* values, float* rewards,
         importance + offset, advantages + offset, gamma, lambda, rho_clip, c_clip, horizon);
 }
 
+// Horizon-parallel variant for few rows. The recurrence
+//     a_t = b_t + c_t*a_{t+1},  b_t = delta_t,  c_t = gamma*lambda*c_clip_t*nnt_{t+1}
+// is a first-order linear scan: the pair (c, b) maps a_{t+1} to a_t, and
+// (c0, b0) after (c1, b1) is (c0*c1, b0 + c0*b1). One block owns one row:
+// tiles are loaded coalesced into shared memory, each thread folds a short
+// contiguous segment, a warp-shuffle + cross-warp suffix scan gives every
+// segment its incoming a, and the segments are replayed and stored coalesced.
+#define SCAN_MAX_HORIZON 2048
+#define SCAN_ARRAYS 5 // values, rewards, dones, importance, advantages
+
+// One padding word per 32 so threads walking contiguous segments hit
+// different banks
+__device__ __forceinline__ int scan_pad(int i) {
+    return i + (i >> 5);
+}
+
+__device__ __forceinline__ void scan_combine(float& c, float& b,
+        float c_later, float b_later) {
+    b = b + c*b_later;
+    c = c*c_later;
+}
+
+__global__ void puff_advantage_scan_kernel(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float gamma,
+        float lambda, float rho_clip, float c_clip, int horizon) {
+    extern __shared__ float smem[];
+    const int padded = scan_pad(horizon) + 1;
+    float* s_values = smem;
+    float* s_rewards = s_values + padded;
+    float* s_dones = s_rewards + padded;
+    float* s_importance = s_dones + padded;
+    float* s_advantages = s_importance + padded;
+    __shared__ float warp_c[32];
+    __shared__ float warp_b[32];
+
+    const size_t offset = (size_t)blockIdx.x*horizon;
+    const int tid = threadIdx.x;
+    const int lane = tid & 31;
+    const int warp = tid >> 5;
+    const int num_warps = (blockDim.x + 31) >> 5;
+
+    for (int i = tid; i < horizon; i += blockDim.x) {
+        s_values[scan_pad(i)] = values[offset + i];
+        s_rewards[scan_pad(i)] = rewards[offset + i];
+        s_dones[scan_pad(i)] = dones[offset + i];
+        s_importance[scan_pad(i)] = importance[offset + i];
+    }
+    __syncthreads();
+
+    // Elements t = 0..horizon-2, split into contiguous per-thread segments
+    const int num_elements = horizon - 1;
+    const int per_thread = (num_elements + blockDim.x - 1) / blockDim.x;
+    const int start = min(tid*per_thread, num_elements);
+    const int end = min(start + per_thread, num_elements);
+    const float gamma_lambda = gamma*lambda;
+
+    // Fold this segment from its last element to its first
+    float seg_c = 1.0f;
+    float seg_b = 0.0f;
+    for (int t = end - 1; t >= start; t--) {
+        float nextnonterminal = 1.0f - s_dones[scan_pad(t + 1)];
+        float imp = s_importance[scan_pad(t)];
+        float rho_t = fminf(imp, rho_clip);
+        float c_t = fminf(imp, c_clip);
+        float delta = rho_t*(s_rewards[scan_pad(t + 1)]
+            + gamma*s_values[scan_pad(t + 1)]*nextnonterminal - s_values[scan_pad(t)]);
+        float c = gamma_lambda*c_t*nextnonterminal;
+        float b = delta;
+        scan_combine(c, b, seg_c, seg_b);
+        seg_c = c;
+        seg_b = b;
+    }
+
+    // Inclusive suffix scan within the warp: lane gets segments lane..31
+    float inc_c = seg_c;
+    float inc_b = seg_b;
+    for (int delta = 1; delta < 32; delta <<= 1) {
+        float later_c = __shfl_down_sync(0xffffffff, inc_c, delta);
+        float later_b = __shfl_down_sync(0xffffffff, inc_b, delta);
+        if (lane + delta < 32) {
+            scan_combine(inc_c, inc_b, later_c, later_b);
+        }
+    }
+    // Exclusive: segments after this lane within the warp
+    float exc_c = __shfl_down_sync(0xffffffff, inc_c, 1);
+    float exc_b = __shfl_down_sync(0xffffffff, inc_b, 1);
+    if (lane == 31) {
+        exc_c = 1.0f;
+        exc_b = 0.0f;
+    }
+    if (lane == 0) {
+        warp_c[warp] = inc_c;
+        warp_b[warp] = inc_b;
+    }
+    __syncthreads();
+
+    // First warp turns the warp totals into each warp's incoming a. The
+    // recurrence starts from a_{horizon-1} = 0, so applying a suffix of
+    // segments to it just yields that suffix's b.
+    if (warp == 0) {
+        float c = lane < num_warps ? warp_c[lane] : 1.0f;
+        float b = lane < num_warps ? warp_b[lane] : 0.0f;
+        for (int delta = 1; delta < 32; delta <<= 1) {
+            float later_c = __shfl_down_sync(0xffffffff, c, delta);
+            float later_b = __shfl_down_sync(0xffffffff, b, delta);
+            if (lane + delta < 32) {
+                scan_combine(c, b, later_c, later_b);
+            }
+        }
+        float next_b = __shfl_down_sync(0xffffffff, b, 1);
+        __syncwarp();
+        if (lane < num_warps) {
+            warp_b[lane] = lane + 1 < num_warps ? next_b : 0.0f;
+        }
+    }
+    __syncthreads();
+
+    // Replay the segment from its incoming a and stage the results
+    float a = exc_b + exc_c*warp_b[warp];
+    for (int t = end - 1; t >= start; t--) {
+        float nextnonterminal = 1.0f - s_dones[scan_pad(t + 1)];
+        float imp = s_importance[scan_pad(t)];
+        float rho_t = fminf(imp, rho_clip);
+        float c_t = fminf(imp, c_clip);
+        float delta = rho_t*(s_rewards[scan_pad(t + 1)]
+            + gamma*s_values[scan_pad(t + 1)]*nextnonterminal - s_values[scan_pad(t)]);
+        a = delta + gamma_lambda*c_t*a*nextnonterminal;
+        s_advantages[scan_pad(t)] = a;
+    }
+    __syncthreads();
+
+    // advantages[horizon-1] is left untouched, as in the row kernel
+    for (int i = tid; i < num_elements; i += blockDim.x) {
+        advantages[offset + i] = s_advantages[scan_pad(i)];
+    }
+}
+
+// The row kernel keeps one thread per row, so it only fills the GPU when
+// there are many rows; below about one 256-thread block per SM the scan
+// kernel spreads each row's horizon over a block instead.
+static bool use_scan_kernel(int device, int num_steps, int horizon) {
+    if (horizon < 64 || horizon > SCAN_MAX_HORIZON) {
+        return false;
+    }
+    int sm_count;
+    cudaDeviceGetAttribute(&sm_count, cudaDevAttrMultiProcessorCount, device);
+    return num_steps < sm_count*256;
+}
+
 void compute_puff_advantage_cuda(torch::Tensor values, torch::Tensor rewards,
         torch::Tensor dones, torch::Tensor importance, torch::Tensor advantages,
         double gamma, double lambda, double rho_clip, double c_clip) {
@@ -58,22 +207,44 @@ void compute_puff_advantage_cuda(torch::Tensor values, torch::Tensor rewards,
     vtrace_check_cuda(values, rewards, dones, importance, advantages, num_steps, horizon);
     TORCH_CHECK(values.is_cuda(), "All tensors must be on GPU");
 
-    int threads_per_block = 256;
-    int blocks = (num_steps + threads_per_block - 1) / threads_per_block;
-
-    puff_advantage_kernel<<<blocks, threads_per_block>>>(
-        values.data_ptr<float>(),
-        rewards.data_ptr<float>(),
-        dones.data_ptr<float>(),
-        importance.data_ptr<float>(),
-        advantages.data_ptr<float>(),
-        gamma,
-        lambda,
-        rho_clip,
-        c_clip,
-        num_steps,
-        horizon
-    );
+    if (num_steps == 0 || horizon < 2) {
+        return;
+    }
+    if (use_scan_kernel(values.get_device(), num_steps, horizon)) {
+        // ~4 timesteps per thread, at least one warp, at most 512 threads
+        int threads = ((horizon/4 + 31)/32)*32;
+        threads = std::min(std::max(threads, 32), 512);
+        size_t shared = SCAN_ARRAYS*(horizon + horizon/32 + 1)*sizeof(float);
+        puff_advantage_scan_kernel<<<num_steps, threads, shared>>>(
+            values.data_ptr<float>(),
+            rewards.data_ptr<float>(),
+            dones.data_ptr<float>(),
+            importance.data_ptr<float>(),
+            advantages.data_ptr<float>(),
+            gamma,
+            lambda,
+            rho_clip,
+            c_clip,
+            horizon
+        );
+    } else {
+        int threads_per_block = 256;
+        int blocks = (num_steps + threads_per_block - 1) / threads_per_block;
+
+        puff_advantage_kernel<<<blocks, threads_per_block>>>(
+            values.data_ptr<float>(),
+            rewards.data_ptr<float>(),
+            dones.data_ptr<float>(),
+            importance.data_ptr<float>(),
+            advantages.data_ptr<float>(),
+            gamma,
+            lambda,
+            rho_clip,
+            c_clip,
+            num_steps,
+            horizon
+        );
+    }
 
     cudaError_t err = cudaGetLastError();
     if (err != cudaSuccess) {
@@ -1,9 +1,16 @@
 #include <Python.h>
 #include <ATen/Operators.h>
+#include <ATen/Parallel.h>
 #include <torch/all.h>
 #include <torch/library.h>
+#include <algorithm>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PUFF_X86 1
+#endif
+
 extern "C" {
   /* Creates a dummy empty _C module that can be imported from Python.
      The import from Python will load the .so consisting of this file
@@ -59,16 +66,171 @@ void vtrace_check(torch::Tensor values, torch::Tensor rewards,
 }
 
 
-// [num_steps, horizon]
+// Lane-parallel recurrence: LANES rows advance through the horizon together,
+// one row per SIMD lane. Rows are contiguous in memory, so each chunk of
+// ADV_TILE_T timesteps is first transposed into a [t][lane] tile (and the
+// advantages transposed back), which keeps every vector load unit-stride.
+constexpr int ADV_TILE_T = 64;
+
+template <int LANES>
+static inline void adv_load_tile(const float* src, int horizon, int t0, int n,
+        float* tile) {
+    for (int l = 0; l < LANES; l++) {
+        const float* row = src + (size_t)l*horizon + t0;
+        for (int i = 0; i < n; i++) {
+            tile[i*LANES + l] = row[i];
+        }
+    }
+}
+
+template <int LANES>
+static inline void adv_store_tile(const float* tile, int horizon, int t0, int n,
+        float* dst) {
+    for (int l = 0; l < LANES; l++) {
+        float* row = dst + (size_t)l*horizon + t0;
+        for (int i = 0; i < n; i++) {
+            row[i] = tile[i*LANES + l];
+        }
+    }
+}
+
+// Tiles for one chunk: t in [t0, t0+n) plus the t_next entry at t0+n
+template <int LANES>
+struct AdvTile {
+    alignas(64) float values[(ADV_TILE_T + 1)*LANES];
+    alignas(64) float rewards[(ADV_TILE_T + 1)*LANES];
+    alignas(64) float dones[(ADV_TILE_T + 1)*LANES];
+    alignas(64) float importance[ADV_TILE_T*LANES];
+    alignas(64) float advantages[ADV_TILE_T*LANES];
+
+    void load(float* values_in, float* rewards_in, float* dones_in,
+            float* importance_in, int horizon, int t0, int n) {
+        adv_load_tile<LANES>(values_in, horizon, t0, n + 1, values);
+        adv_load_tile<LANES>(rewards_in, horizon, t0, n + 1, rewards);
+        adv_load_tile<LANES>(dones_in, horizon, t0, n + 1, dones);
+        adv_load_tile<LANES>(importance_in, horizon, t0, n, importance);
+    }
+};
+
+#ifdef PUFF_X86
+__attribute__((target("avx2")))
+static void puff_advantage_rows8_avx2(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float gamma,
+        float lambda, float rho_clip, float c_clip, int horizon) {
+    AdvTile<8> tile;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 gamma_v = _mm256_set1_ps(gamma);
+    const __m256 gamma_lambda = _mm256_set1_ps(gamma*lambda);
+    const __m256 rho_clip_v = _mm256_set1_ps(rho_clip);
+    const __m256 c_clip_v = _mm256_set1_ps(c_clip);
+    __m256 lastpufferlam = _mm256_setzero_ps();
+    // Same order as puff_advantage_row: t from horizon-2 down to 0
+    for (int end = horizon - 1; end > 0; end -= ADV_TILE_T) {
+        int t0 = std::max(0, end - ADV_TILE_T);
+        int n = end - t0;
+        tile.load(values, rewards, dones, importance, horizon, t0, n);
+        for (int i = n - 1; i >= 0; i--) {
+            __m256 nextnonterminal = _mm256_sub_ps(one, _mm256_load_ps(tile.dones + (i + 1)*8));
+            __m256 imp = _mm256_load_ps(tile.importance + i*8);
+            __m256 rho_t = _mm256_min_ps(imp, rho_clip_v);
+            __m256 c_t = _mm256_min_ps(imp, c_clip_v);
+            __m256 next = _mm256_mul_ps(_mm256_mul_ps(gamma_v,
+                _mm256_load_ps(tile.values + (i + 1)*8)), nextnonterminal);
+            __m256 delta = _mm256_mul_ps(rho_t, _mm256_sub_ps(_mm256_add_ps(
+                _mm256_load_ps(tile.rewards + (i + 1)*8), next),
+                _mm256_load_ps(tile.values + i*8)));
+            lastpufferlam = _mm256_add_ps(delta, _mm256_mul_ps(_mm256_mul_ps(
+                _mm256_mul_ps(gamma_lambda, c_t), lastpufferlam), nextnonterminal));
+            _mm256_store_ps(tile.advantages + i*8, lastpufferlam);
+        }
+        adv_store_tile<8>(tile.advantages, horizon, t0, n, advantages);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void puff_advantage_rows16_avx512(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float gamma,
+        float lambda, float rho_clip, float c_clip, int horizon) {
+    AdvTile<16> tile;
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 gamma_v = _mm512_set1_ps(gamma);
+    const __m512 gamma_lambda = _mm512_set1_ps(gamma*lambda);
+    const __m512 rho_clip_v = _mm512_set1_ps(rho_clip);
+    const __m512 c_clip_v = _mm512_set1_ps(c_clip);
+    __m512 lastpufferlam = _mm512_setzero_ps();
+    for (int end = horizon - 1; end > 0; end -= ADV_TILE_T) {
+        int t0 = std::max(0, end - ADV_TILE_T);
+        int n = end - t0;
+        tile.load(values, rewards, dones, importance, horizon, t0, n);
+        for (int i = n - 1; i >= 0; i--) {
+            __m512 nextnonterminal = _mm512_sub_ps(one, _mm512_load_ps(tile.dones + (i + 1)*16));
+            __m512 imp = _mm512_load_ps(tile.importance + i*16);
+            __m512 rho_t = _mm512_min_ps(imp, rho_clip_v);
+            __m512 c_t = _mm512_min_ps(imp, c_clip_v);
+            __m512 next = _mm512_mul_ps(_mm512_mul_ps(gamma_v,
+                _mm512_load_ps(tile.values + (i + 1)*16)), nextnonterminal);
+            __m512 delta = _mm512_mul_ps(rho_t, _mm512_sub_ps(_mm512_add_ps(
+                _mm512_load_ps(tile.rewards + (i + 1)*16), next),
+                _mm512_load_ps(tile.values + i*16)));
+            lastpufferlam = _mm512_add_ps(delta, _mm512_mul_ps(_mm512_mul_ps(
+                _mm512_mul_ps(gamma_lambda, c_t), lastpufferlam), nextnonterminal));
+            _mm512_store_ps(tile.advantages + i*16, lastpufferlam);
+        }
+        adv_store_tile<16>(tile.advantages, horizon, t0, n, advantages);
+    }
+}
+#endif
+
+typedef void (*AdvRowsFn)(float*, float*, float*, float*, float*, float, float,
+        float, float, int);
+
+// Widest lane kernel this CPU runs, or lanes = 1 for the scalar rows
+static AdvRowsFn puff_advantage_rows_kernel(int* lanes) {
+#ifdef PUFF_X86
+    if (__builtin_cpu_supports("avx512f")) {
+        *lanes = 16;
+        return puff_advantage_rows16_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        *lanes = 8;
+        return puff_advantage_rows8_avx2;
+    }
+#endif
+    *lanes = 1;
+    return nullptr;
+}
+
+// [num_steps, horizon]. Blocks of `lanes` rows are split across ATen's
+// intra-op threads; leftover rows (and CPUs without AVX2) use the scalar row.
 void puff_advantage(float* values, float* rewards, float* dones, float* importance,
         float* advantages, float gamma, float lambda, float rho_clip, float c_clip,
         int num_steps, const int horizon){
-    for (int offset = 0; offset < num_steps*horizon; offset+=horizon) {
-        puff_advantage_row(values + offset, rewards + offset,
-            dones + offset, importance + offset, advantages + offset,
-            gamma, lambda, rho_clip, c_clip, horizon
-        );
+    if (horizon < 2) {
+        return;
     }
+    static int lanes = 0;
+    static AdvRowsFn rows_kernel = puff_advantage_rows_kernel(&lanes);
+    int64_t num_blocks = (num_steps + lanes - 1) / lanes;
+    // Roughly 32K elements per task so small buffers stay on one thread
+    int64_t grain = std::max<int64_t>(1, 32768 / ((int64_t)lanes*horizon));
+    at::parallel_for(0, num_blocks, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t block = begin; block < end; block++) {
+            int row = (int)block*lanes;
+            size_t offset = (size_t)row*horizon;
+            if (rows_kernel && row + lanes <= num_steps) {
+                rows_kernel(values + offset, rewards + offset, dones + offset,
+                    importance + offset, advantages + offset,
+                    gamma, lambda, rho_clip, c_clip, horizon);
+                continue;
+            }
+            for (int r = row; r < std::min(row + lanes, num_steps); r++) {
+                size_t o = (size_t)r*horizon;
+                puff_advantage_row(values + o, rewards + o, dones + o,
+                    importance + o, advantages + o,
+                    gamma, lambda, rho_clip, c_clip, horizon);
+            }
+        }
+    });
 }
 
 
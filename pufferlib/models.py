@@ -8,6 +8,68 @@ import pufferlib.emulation
 import pufferlib.pytorch
 import pufferlib.spaces
 
+def unpack_2bpp(packed, height, width):
+    '''Expands 2-bit packed screens (4 pixels per byte, first pixel in the
+    low bits) to a (batch, height, width) uint8 tensor of values 0-3'''
+    shifts = torch.tensor([0, 2, 4, 6], dtype=torch.uint8, device=packed.device)
+    pixels = (packed.to(torch.uint8).unsqueeze(-1) >> shifts) & 3
+    return pixels.view(packed.shape[0], height, width)
+
+class TilemapEncoder(nn.Module):
+    '''Embeds Game Boy tilemap observations: rows x cols background tile
+    indices followed by num_sprites raw OAM entries (y, x, tile, flags).
+
+    Tiles share one embedding table and go through a small conv stack;
+    sprites are embedded by tile with their normalized position and flags,
+    then mean-pooled over the visible ones (OAM y of 0 or >= 160 is
+    offscreen). Output size is self.output_size.'''
+    def __init__(self, rows=18, cols=20, num_sprites=40, embed_dim=16,
+            sprite_dim=32):
+        super().__init__()
+        self.rows = rows
+        self.cols = cols
+        self.num_tiles = rows * cols
+        self.num_sprites = num_sprites
+        self.input_size = self.num_tiles + 4 * num_sprites
+
+        self.tile_embed = nn.Embedding(256, embed_dim)
+        self.cnn = nn.Sequential(
+            pufferlib.pytorch.layer_init(nn.Conv2d(embed_dim, 32, 3, padding=1)),
+            nn.ReLU(),
+            pufferlib.pytorch.layer_init(nn.Conv2d(32, 64, 3, stride=2)),
+            nn.ReLU(),
+            nn.Flatten(),
+        )
+        with torch.no_grad():
+            cnn_out_size = self.cnn(torch.zeros(1, embed_dim, rows, cols)).shape[1]
+
+        self.sprite_embed = nn.Embedding(256, embed_dim)
+        self.sprite_proj = nn.Sequential(
+            pufferlib.pytorch.layer_init(nn.Linear(embed_dim + 2 + 8, sprite_dim)),
+            nn.ReLU(),
+        )
+        self.output_size = cnn_out_size + sprite_dim
+
+    def forward(self, observations):
+        batch = observations.shape[0]
+        obs = observations[:, :self.input_size].long()
+
+        tiles = self.tile_embed(obs[:, :self.num_tiles])
+        tiles = tiles.view(batch, self.rows, self.cols, -1).permute(0, 3, 1, 2)
+        tile_net = self.cnn(tiles)
+
+        oam = obs[:, self.num_tiles:].view(batch, self.num_sprites, 4)
+        y, x, tile, flags = oam.unbind(dim=-1)
+        pos = torch.stack([y.float() / 160.0, x.float() / 168.0], dim=-1)
+        bits = torch.arange(8, device=obs.device)
+        flag_bits = ((flags.unsqueeze(-1) >> bits) & 1).float()
+        sprites = torch.cat([self.sprite_embed(tile), pos, flag_bits], dim=-1)
+        sprites = self.sprite_proj(sprites)
+        visible = ((y > 0) & (y < 160)).float().unsqueeze(-1)
+        sprite_net = (sprites * visible).sum(dim=1) / visible.sum(dim=1).clamp(min=1)
+
+        return torch.cat([tile_net, sprite_net], dim=1)
+
 
 class Default(nn.Module):
     '''Default PyTorch policy. Flattens obs and applies a linear layer.
@@ -123,6 +123,8 @@ class PuffeRL:
             )
 
         device = config['device']
+        self.pinned_buffers = (torch.device(device).type == 'cuda'
+            and getattr(vecenv, 'pinned', None) is not None)
         self.observations = torch.zeros(segments, horizon, *obs_space.shape,
             dtype=pufferlib.pytorch.numpy_to_torch_dtype_dict[obs_space.dtype],
             pin_memory=device == 'cuda' and config['cpu_offload'],
@@ -273,10 +275,13 @@ class PuffeRL:
             self.global_step += int(mask.sum())
 
             profile('eval_copy', epoch)
+            # Pinned vecenv buffers copy async. action.cpu() below syncs the
+            # stream before send() lets the workers overwrite them.
+            non_blocking = self.pinned_buffers
             o = torch.as_tensor(o)
-            o_device = o.to(device)#, non_blocking=True)
-            r = torch.as_tensor(r).to(device)#, non_blocking=True)
-            d = torch.as_tensor(d).to(device)#, non_blocking=True)
+            o_device = o.to(device, non_blocking=non_blocking)
+            r = torch.as_tensor(r).to(device, non_blocking=non_blocking)
+            d = torch.as_tensor(d).to(device, non_blocking=non_blocking)
 
             profile('eval_forward', epoch)
             with torch.no_grad(), self.amp_context:
@@ -49,6 +49,40 @@ def step(vecenv, actions):
     obs, rewards, terminals, truncations, infos, env_ids, masks = vecenv.recv()
     return obs, rewards, terminals, truncations, infos # include env_ids or no?
 
+def pin_buffers(arrays):
+    '''Page-locks existing host arrays in place with cudaHostRegister
+
+    The arrays keep their memory (shared RawArrays stay shared with forked
+    workers), so H2D copies from them can be issued non_blocking straight
+    from the buffer the C envs wrote. Returns the registered pointers for
+    unpin_buffers, or None if CUDA is unavailable or registration failed.'''
+    try:
+        import torch
+    except ImportError:
+        return None
+    if not torch.cuda.is_available():
+        return None
+
+    cudart = torch.cuda.cudart()
+    pinned = []
+    for arr in arrays:
+        ptr = arr.ctypes.data
+        if int(cudart.cudaHostRegister(ptr, arr.nbytes, 0)) != 0:
+            unpin_buffers(pinned)
+            return None
+        pinned.append(ptr)
+
+    return pinned
+
+def unpin_buffers(pinned):
+    if not pinned:
+        return
+
+    import torch
+    cudart = torch.cuda.cudart()
+    for ptr in pinned:
+        cudart.cudaHostUnregister(ptr)
+
 class Serial:
     reset = reset
     step = step
@@ -169,8 +203,15 @@ class Serial:
         for env in self.envs:
             env.close()
 
+# (worker_idx, num_workers) of the Multiprocessing worker this process runs,
+# (0, 1) outside one. Native envs read it to share the machine's cores with
+# their sibling workers instead of each assuming it has all of them.
+WORKER_SLOT = (0, 1)
+
 def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, atn_shape, atn_dtype,
         num_envs, num_agents, num_workers, worker_idx, send_pipe, recv_pipe, shm, is_native, seed):
+    global WORKER_SLOT
+    WORKER_SLOT = (worker_idx, num_workers)
 
     # Environments read and write directly to shared memory
     shape = (num_workers, num_envs*num_agents)
@@ -237,7 +278,8 @@ class Multiprocessing:
  
     def __init__(self, env_creators, env_args, env_kwargs,
             num_envs, num_workers=None, batch_size=None,
-            zero_copy=True, sync_traj=True, overwork=False, seed=0, **kwargs):
+            zero_copy=True, sync_traj=True, overwork=False, pin_memory=False,
+            seed=0, **kwargs):
         if batch_size is None:
             batch_size = num_envs
         if num_workers is None:
@@ -345,6 +387,27 @@ class Multiprocessing:
             p.start()
             self.processes.append(p)
 
+        # Workers write straight into the pinned pages. Non-contiguous
+        # batches are gathered into a pinned staging buffer instead of a
+        # fresh pageable array so the learner's copy can still be async.
+        # Registration initializes CUDA, so it waits until every worker has
+        # been forked.
+        self.pinned = None
+        self.staging = None
+        if pin_memory:
+            staging = dict(
+                observations=np.zeros((self.workers_per_batch, agents_per_worker,
+                    *obs_shape), dtype=obs_dtype),
+                rewards=np.zeros((self.workers_per_batch, agents_per_worker),
+                    dtype=np.float32),
+                terminals=np.zeros((self.workers_per_batch, agents_per_worker),
+                    dtype=bool),
+            )
+            self.pinned = pin_buffers([self.buf['observations'],
+                self.buf['rewards'], self.buf['terminals'], *staging.values()])
+            if self.pinned is not None:
+                self.staging = staging
+
         self.flag = RESET
         self.initialized = False
         self.zero_copy = zero_copy
@@ -427,9 +490,18 @@ class Multiprocessing:
         self.w_slice = w_slice
         buf = self.buf
 
-        o = buf['observations'][w_slice].reshape(self.obs_batch_shape)
-        r = buf['rewards'][w_slice].ravel()
-        d = buf['terminals'][w_slice].ravel()
+        if self.staging is not None and isinstance(w_slice, list):
+            staging = self.staging
+            np.take(buf['observations'], w_slice, axis=0, out=staging['observations'])
+            np.take(buf['rewards'], w_slice, axis=0, out=staging['rewards'])
+            np.take(buf['terminals'], w_slice, axis=0, out=staging['terminals'])
+            o = staging['observations'].reshape(self.obs_batch_shape)
+            r = staging['rewards'].ravel()
+            d = staging['terminals'].ravel()
+        else:
+            o = buf['observations'][w_slice].reshape(self.obs_batch_shape)
+            r = buf['rewards'][w_slice].ravel()
+            d = buf['terminals'][w_slice].ravel()
         t = buf['truncations'][w_slice].ravel()
 
         infos = []
@@ -487,6 +559,9 @@ class Multiprocessing:
         for p in self.processes:
             p.terminate()
 
+        unpin_buffers(self.pinned)
+        self.pinned = None
+
 class Ray():
     '''Runs environments in parallel on multiple processes using Ray
 
@@ -636,6 +711,18 @@ def make(env_creator_or_creators, env_args=None, env_kwargs=None, backend=Puffer
         if num_envs != 1:
             raise pufferlib.APIUsageError('Native vectorization is for PufferEnvs that handle all per-process vectorization internally. If you want to run multiple separate Python instances on a single process, use Serial or Multiprocessing instead')
 
+        if kwargs.get('pin_memory', False):
+            vecenv.pinned = pin_buffers(
+                [vecenv.observations, vecenv.rewards, vecenv.terminals])
+            if vecenv.pinned is not None:
+                # The env owns the arrays, so unregister before it can free them
+                env_close = vecenv.close
+                def close():
+                    unpin_buffers(vecenv.pinned)
+                    vecenv.pinned = None
+                    env_close()
+                vecenv.close = close
+
         return vecenv
 
     if 'num_workers' in kwargs:
@@ -700,7 +787,7 @@ def make(env_creator_or_creators, env_args=None, env_kwargs=None, backend=Puffer
 
     # Sanity check args
     for k in kwargs:
-        if k not in ['num_workers', 'batch_size', 'zero_copy', 'overwork', 'backend']:
+        if k not in ['num_workers', 'batch_size', 'zero_copy', 'overwork', 'backend', 'pin_memory']:
             raise pufferlib.APIUsageError(f'Invalid argument: {k}')
 
     # TODO: First step action space check
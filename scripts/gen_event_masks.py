@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Generate pokered/includes/event_masks.h from EVENT_LIST in events.h.
+
+Folds the per-bit event entries into one {address, mask} pair per flag byte
+so calc_event_sum can AND + popcount whole bytes.
+
+Usage: python3 scripts/gen_event_masks.py [--check]
+  --check  exit non-zero if the committed header is out of date
+"""
+import os
+import re
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+EVENTS_H = os.path.join(ROOT, 'pokered', 'includes', 'events.h')
+MASKS_H = os.path.join(ROOT, 'pokered', 'includes', 'event_masks.h')
+
+ENTRY = re.compile(r'^\{\s*(0x[0-9A-Fa-f]+)\s*,\s*(\d+)\s*,\s*"[^"]*"\s*\},?$')
+
+
+def parse_events(path):
+    src = open(path).read()
+    start = src.index('EVENT_LIST[] = {')
+    end = src.index('};', start)
+    events = []
+    for line in src[start:end].splitlines()[1:]:
+        line = line.strip()
+        if not line or line.startswith('//'):
+            continue
+        m = ENTRY.match(line)
+        if not m:
+            sys.exit(f'gen_event_masks: cannot parse EVENT_LIST line: {line}')
+        addr, bit = int(m.group(1), 16), int(m.group(2))
+        if not 0 <= bit < 8:
+            sys.exit(f'gen_event_masks: bit out of range: {line}')
+        events.append((addr, bit))
+    return events
+
+
+def render(events):
+    masks = {}
+    for addr, bit in events:
+        masks[addr] = masks.get(addr, 0) | (1 << bit)
+    lines = [
+        '// Generated by scripts/gen_event_masks.py from events.h - do not edit',
+        '#ifndef EVENT_MASKS_H',
+        '#define EVENT_MASKS_H',
+        '',
+        '#include <stdint.h>',
+        '',
+        'typedef struct {',
+        '  uint16_t address;',
+        '  uint8_t mask; // EVENT_LIST bits tracked at this address',
+        '} EventMask;',
+        '',
+        f'#define EVENT_MASK_COUNT {len(masks)}',
+        f'#define EVENT_MASK_BITS {len(events)} // == EVENT_COUNT',
+        '',
+        'static const EventMask EVENT_MASKS[EVENT_MASK_COUNT] = {',
+    ]
+    lines += [f'    {{0x{addr:04X}, 0x{mask:02X}}},' for addr, mask in sorted(masks.items())]
+    lines += ['};', '', '#endif // EVENT_MASKS_H', '']
+    return '\n'.join(lines)
+
+
+def main():
+    out = render(parse_events(EVENTS_H))
+    if '--check' in sys.argv[1:]:
+        current = open(MASKS_H).read() if os.path.exists(MASKS_H) else ''
+        if current != out:
+            sys.exit('event_masks.h is stale, run scripts/gen_event_masks.py')
+        return
+    with open(MASKS_H, 'w') as f:
+        f.write(out)
+
+
+if __name__ == '__main__':
+    main()
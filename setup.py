@@ -21,6 +21,8 @@ from torch.utils.cpp_extension import (
 
 # Build with DEBUG=1 to enable debug symbols
 DEBUG = os.getenv("DEBUG", "0") == "1"
+# Build with NATIVE=1 to use the host's SIMD extensions (AVX2/SSE4.1 obs kernels)
+NATIVE = os.getenv("NATIVE", "0") == "1"
 
 # Shared compile args for all platforms
 extra_compile_args = [
@@ -68,6 +70,11 @@ else:
         '-O3',
     ]
 
+if NATIVE:
+    extra_compile_args += [
+        '-march=native',
+    ]
+
 system = platform.system()
 if system == 'Linux':
     extra_compile_args += [
@@ -158,7 +165,7 @@ for c_ext in c_extensions:
             sdl_libs = ['-lSDL2']
 
         c_ext.extra_compile_args.extend(flag for flag in sdl_cflags if flag)
-        c_ext.extra_link_args.extend(['-lmgba'])
+        c_ext.extra_link_args.extend(['-lmgba', '-lrt'])
         c_ext.extra_link_args.extend(flag for flag in sdl_libs if flag)
 
 
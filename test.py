@@ -7,10 +7,16 @@ Usage:
     python pokered.py              # Run quick test (100 steps)
     python pokered.py 1000         # Run benchmark (1000 steps)
     python pokered.py --full       # Run full test suite
+    python pokered.py --features   # Snapshot, recorder, obs mode, advantage, visit map checks
 """
 
+import os
 import sys
+import glob
 import time
+import tempfile
+import subprocess
+import multiprocessing
 import argparse
 import numpy as np
 import warnings
@@ -125,6 +131,285 @@ def test_observation_values(env):
     print(f'       RAM state sample (x,y,map,badges,party): {ram_obs[0]}')
 
 
+def test_snapshot_restore():
+    """Test that a restored snapshot replays the same steps, in any env."""
+    print('[TEST] Snapshot / restore round trip...')
+    env = create_env(num_envs=2)
+    env.reset()
+    rng = np.random.default_rng(0)
+    for _ in range(50):
+        env.step(rng.integers(0, 9, size=env.num_agents))
+
+    handles = env.snapshot([0])
+    start = env.observations[0].copy()
+    actions = rng.integers(0, 9, size=(40, env.num_agents))
+    trajectory = []
+    for a in actions:
+        obs, rewards, _, _, _ = env.step(a)
+        trajectory.append((obs[0].copy(), rewards[0]))
+
+    # Back into the env it came from, then into the other one
+    for target in (0, 1):
+        env.restore([target], handles)
+        assert np.array_equal(env.observations[target], start), \
+            f'Env {target} obs differs right after restore'
+        for i, a in enumerate(actions):
+            a = a.copy()
+            a[target] = actions[i][0]
+            obs, rewards, _, _, _ = env.step(a)
+            assert np.array_equal(obs[target], trajectory[i][0]), \
+                f'Env {target} obs diverged {i} steps after restore'
+            assert rewards[target] == trajectory[i][1], \
+                f'Env {target} reward diverged {i} steps after restore'
+
+    # Released handles are rejected, including after their slot is reused
+    env.release(handles)
+    fresh = env.snapshot([0])
+    for stale in (handles, [0], [-1]):
+        try:
+            env.restore([0], stale)
+        except KeyError:
+            pass
+        else:
+            raise AssertionError(f'Restore accepted stale handle {stale}')
+    env.restore([1], fresh)
+    env.release(fresh)
+    env.close()
+    print('[PASS] Restored envs replayed 40 steps exactly; stale handles rejected')
+
+
+def test_recorder_replay(replay_bin='./pokered_replay'):
+    """Test that recorded trajectories replay without desyncs."""
+    print('[TEST] Recorder encode -> replay determinism...')
+    if not os.path.exists(replay_bin):
+        print(f'[SKIP] {replay_bin} not found, build it with make pokered_replay')
+        return
+    with tempfile.TemporaryDirectory() as record_dir:
+        env = create_env(num_envs=1, record_dir=record_dir,
+                         record_keyframe_interval=64)
+        env.reset()
+        # Long runs of one button exercise the RLE action chunks
+        rng = np.random.default_rng(0)
+        actions = np.repeat(rng.integers(0, 9, size=60), rng.integers(1, 20, size=60))
+        for i, a in enumerate(actions):
+            env.step(np.array([a]))
+            if i == len(actions) // 3:
+                handles = env.snapshot([0])
+            elif i == len(actions) // 2:
+                env.reset()  # new segment from state_path
+        env.restore([0], handles)  # new segment from a keyframe
+        env.release(handles)
+        for a in actions[:200]:
+            env.step(np.array([a]))
+        env.close()
+
+        paths = glob.glob(os.path.join(record_dir, '*.prr'))
+        assert len(paths) == 1, f'Expected one recording, found {paths}'
+        rom = ['--rom', DEFAULT_ENV_CONFIG['rom_path']]
+        listing = subprocess.run([replay_bin, '-l', *rom, paths[0]],
+                                 capture_output=True, text=True)
+        assert listing.returncode == 0, f'Listing failed: {listing.stderr}'
+        check = subprocess.run([replay_bin, *rom, paths[0]],
+                               capture_output=True, text=True)
+        # Exit code 2 means a keyframe did not match the replayed state
+        assert check.returncode == 0, \
+            f'Replay failed ({check.returncode}): {check.stdout}{check.stderr}'
+    print(f'[PASS] {check.stdout.strip()}')
+
+
+def test_obs_modes(n_steps=50):
+    """Test every obs_mode on the same trajectory against the float32 screen."""
+    from pokered.pokered import OBS_MODES, TILEMAP_ROWS, TILEMAP_COLS
+    print('[TEST] Observation modes...')
+    actions = np.random.default_rng(0).integers(0, 9, size=(n_steps, 2))
+    obs = {}
+    for mode, (_, dtype) in OBS_MODES.items():
+        env = create_env(num_envs=2, obs_mode=mode)
+        env.reset()
+        for a in actions:
+            env.step(a)
+        o = env.observations.copy()
+        env.close()
+        assert o.dtype == dtype, f'{mode}: dtype {o.dtype}, expected {dtype}'
+        assert o.shape == (2,) + env.single_observation_space.shape, \
+            f'{mode}: shape {o.shape}'
+        assert o.min() >= 0 and o.max() <= 255, f'{mode}: values out of range'
+        obs[mode] = o
+
+    # Same game state in every mode: the RAM extras must agree
+    for mode, o in obs.items():
+        assert np.array_equal(o[:, -5:], obs['float32'][:, -5:]), \
+            f'{mode}: RAM extras {o[:, -5:]} != {obs["float32"][:, -5:]}'
+
+    # Integer luma vs the float formula: at most rounding apart
+    screen = obs['float32'][:, :-5]
+    diff = np.abs(obs['uint8'][:, :-5].astype(np.float32) - screen).max()
+    assert diff <= 2, f'uint8 screen differs from float32 by {diff}'
+
+    # 2-bit shades, first pixel in the low bits, 40 bytes per 160-pixel row
+    packed = obs['packed'][:, :-5]
+    shades = (packed[..., None] >> np.array([0, 2, 4, 6], dtype=np.uint8)) & 3
+    shades = shades.reshape(2, 144, 160)
+    # Wherever a 2x2 block is a single shade, its pooled grey is that shade's
+    # palette entry, so each shade maps to exactly one uint8 value
+    blocks = shades.reshape(2, 72, 2, 80, 2).transpose(0, 1, 3, 2, 4).reshape(2, 72, 80, 4)
+    uniform = (blocks == blocks[..., :1]).all(-1)
+    grey = obs['uint8'][:, :-5].reshape(2, 72, 80)
+    for shade in range(4):
+        values = np.unique(grey[uniform & (blocks[..., 0] == shade)])
+        assert len(values) <= 1, f'packed shade {shade} pools to {values}'
+
+    tiles = obs['tilemap'][:, :TILEMAP_ROWS * TILEMAP_COLS]
+    assert all(len(np.unique(t)) > 1 for t in tiles), 'tilemap is a single tile'
+    print(f'[PASS] {", ".join(OBS_MODES)} agree; uint8 within {diff:.2f} of float32')
+
+
+def advantage_reference(values, rewards, dones, importance, gamma, lam,
+                        rho_clip, c_clip):
+    """puff_advantage_row in numpy, all rows at once."""
+    advantages = np.zeros_like(values)
+    lastpufferlam = np.zeros(values.shape[0], dtype=np.float32)
+    for t in range(values.shape[1] - 2, -1, -1):
+        nextnonterminal = 1.0 - dones[:, t + 1]
+        rho_t = np.minimum(importance[:, t], rho_clip)
+        c_t = np.minimum(importance[:, t], c_clip)
+        delta = rho_t * (rewards[:, t + 1] + gamma * values[:, t + 1] * nextnonterminal - values[:, t])
+        lastpufferlam = delta + gamma * lam * c_t * lastpufferlam * nextnonterminal
+        advantages[:, t] = lastpufferlam
+    return advantages
+
+
+def advantage_inputs(rng, num_steps, horizon):
+    shape = (num_steps, horizon)
+    return (rng.standard_normal(shape, dtype=np.float32),
+            rng.standard_normal(shape, dtype=np.float32),
+            (rng.random(shape) < 0.05).astype(np.float32),
+            rng.uniform(0.5, 1.5, shape).astype(np.float32))
+
+
+def run_advantage_op(inputs, device, gamma=0.99, lam=0.95, rho_clip=1.1, c_clip=0.9):
+    import torch
+    tensors = [torch.from_numpy(x).to(device) for x in inputs]
+    advantages = torch.zeros_like(tensors[0])
+    torch.ops.pufferlib.compute_puff_advantage(*tensors, advantages,
+        gamma, lam, rho_clip, c_clip)
+    return advantages.cpu().numpy()
+
+
+def test_advantage_cpu():
+    """Test the threaded SIMD CPU advantage op against the scalar recurrence."""
+    print('[TEST] CPU advantage kernel...')
+    try:
+        from pufferlib import _C
+    except ImportError:
+        print('[SKIP] pufferlib._C is not built')
+        return
+    rng = np.random.default_rng(0)
+    worst = 0.0
+    # Row counts around the 8/16 SIMD lanes, horizons around the 64-step tile
+    for num_steps in (1, 7, 8, 9, 16, 17, 33, 256):
+        for horizon in (1, 2, 3, 63, 64, 65, 129, 512):
+            inputs = advantage_inputs(rng, num_steps, horizon)
+            expected = advantage_reference(*inputs, 0.99, 0.95, 1.1, 0.9)
+            err = np.abs(run_advantage_op(inputs, 'cpu') - expected).max(initial=0)
+            assert err < 1e-4, f'{num_steps}x{horizon}: max abs error {err}'
+            worst = max(worst, err)
+    print(f'[PASS] CPU advantages match the scalar rows (max abs error {worst:.2e})')
+
+
+def test_advantage_cuda():
+    """Test both CUDA advantage kernels against the CPU op."""
+    print('[TEST] CUDA advantage kernels...')
+    try:
+        import torch
+        from pufferlib import _C
+    except ImportError:
+        print('[SKIP] pufferlib._C is not built')
+        return
+    if not torch.cuda.is_available():
+        print('[SKIP] no CUDA device')
+        return
+    rng = np.random.default_rng(0)
+    worst = 0.0
+    # Few rows with 64..2048 steps take the horizon-parallel scan; many rows,
+    # or horizons outside that range, take one thread per row
+    for num_steps in (1, 3, 32, 4096):
+        for horizon in (2, 63, 64, 65, 100, 1000, 2048, 2049):
+            inputs = advantage_inputs(rng, num_steps, horizon)
+            expected = run_advantage_op(inputs, 'cpu')
+            err = np.abs(run_advantage_op(inputs, 'cuda') - expected).max()
+            # The scan reassociates the recurrence, so allow for float error
+            tol = 1e-3 * max(1.0, np.abs(expected).max())
+            assert err < tol, f'{num_steps}x{horizon}: max abs error {err}'
+            worst = max(worst, err)
+    print(f'[PASS] CUDA advantages match the CPU op (max abs error {worst:.2e})')
+
+
+def _visit_map_worker(name, n_steps, go, result):
+    go.wait()
+    env = create_env(num_envs=2, visit_map_blocks=1024, visit_map_name=name)
+    env.reset()
+    for _ in range(n_steps):
+        env.step(np.random.randint(0, 9, size=env.num_agents))
+    _, counts = env.visit_map()
+    env.close()
+    result.put(int(counts.sum()))
+
+
+def test_visit_map_shared(n_steps=300):
+    """Test that forked workers share one visit map that outlives close()."""
+    print('[TEST] Shared visit map across processes...')
+    name = f'pokered_visits_test_{os.getpid()}'
+    # Fork before any env exists, the way vector workers are started
+    ctx = multiprocessing.get_context('fork')
+    go, result = ctx.Event(), ctx.Queue()
+    worker = ctx.Process(target=_visit_map_worker, args=(name, n_steps, go, result))
+    worker.start()
+
+    env = create_env(num_envs=2, visit_map_blocks=1024, visit_map_name=name)
+    env.reset()
+    for _ in range(n_steps):
+        env.step(np.random.randint(0, 9, size=env.num_agents))
+    directory, counts = env.visit_map()
+    own = int(counts.sum())
+    assert own > 0, 'No tile visits were counted'
+
+    go.set()
+    worker_total = result.get(timeout=300)
+    worker.join()
+    assert worker.exitcode == 0, f'Worker exited with {worker.exitcode}'
+    # The worker saw this process's visits plus its own, and this view sees
+    # everything the worker added
+    shared = int(counts.sum())
+    assert shared == worker_total > own, \
+        f'Not shared: own {own}, worker saw {worker_total}, now {shared}'
+
+    # Views keep the segment mapped after close
+    env.close()
+    assert int(counts.sum()) == shared, 'Counts changed after close'
+    blocks = directory[directory > 0] - 1
+    assert len(np.unique(blocks)) == len(blocks), 'Block mapped by two directory entries'
+    assert int(counts[blocks].sum()) == shared, 'Counts outside the directory blocks'
+    print(f'[PASS] {shared} visits in {len(blocks)} blocks shared by 2 processes; '
+          f'views valid after close')
+
+
+def run_feature_tests():
+    """Checks for the snapshot, recorder, observation, advantage and visit map features."""
+    test_snapshot_restore()
+    print()
+    test_recorder_replay()
+    print()
+    test_obs_modes()
+    print()
+    test_advantage_cpu()
+    print()
+    test_advantage_cuda()
+    print()
+    test_visit_map_shared()
+    print()
+
+
 def test_multi_env_scaling(max_envs=24):
     """Test scaling with multiple environments."""
     print(f'scaling up to {max_envs} envs...\n')
@@ -234,11 +519,14 @@ def run_full_test_suite():
     test_close(env)
     print()
     
-    # Test 3: Scaling test
+    # Test 3: Feature checks
+    run_feature_tests()
+
+    # Test 4: Scaling test
     test_multi_env_scaling(max_envs=32)
     print()
     
-    # Test 4: Benchmark
+    # Test 5: Benchmark
     run_benchmark(n_steps=500, num_envs=8)
     
     print('\n' + '='*60)
@@ -252,6 +540,8 @@ if __name__ == '__main__':
                         help='Number of steps for quick test/benchmark')
     parser.add_argument('--full', action='store_true',
                         help='Run full test suite')
+    parser.add_argument('--features', action='store_true',
+                        help='Run the snapshot, recorder, obs mode, advantage and visit map checks')
     parser.add_argument('--scale', action='store_true',
                         help="Test for training speed")
     parser.add_argument('--envs', type=int, default=8,
@@ -262,6 +552,8 @@ if __name__ == '__main__':
     
     if args.full:
         run_full_test_suite()
+    elif args.features:
+        run_feature_tests()
     elif args.benchmark:
         run_benchmark(n_steps=args.steps, num_envs=args.envs)
     elif args.scale: